@@ -0,0 +1,118 @@
+#include "admission_control.h"
+
+#include <algorithm>
+
+using namespace std::string_literals;
+
+QueryRejectedError::QueryRejectedError(size_t cost)
+        : std::runtime_error("Запрос отклонен: сервер перегружен, стоимость запроса "s + std::to_string(cost))
+        , cost_(cost) {
+}
+
+size_t QueryRejectedError::GetCost() const {
+    return cost_;
+}
+
+AdmissionController::AdmissionController(const SearchServer& search_server, const AdmissionPolicy& policy)
+        : search_server_(search_server)
+        , policy_(policy) {
+}
+
+std::vector<Document> AdmissionController::FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                                            const QueryOptions& options) {
+    const SearchServer::PreparedQuery query = search_server_.PrepareQuery(raw_query);
+    const Ticket ticket = Admit(query.GetCost());
+    if (ticket.GetDecision() == Decision::DEGRADED) {
+        return search_server_.FindTopDocuments(query, status, Degrade(options));
+    }
+    return search_server_.FindTopDocuments(query, status, options);
+}
+
+std::vector<Document> AdmissionController::FindTopDocuments(std::string_view raw_query, const QueryOptions& options) {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL, options);
+}
+
+std::vector<std::vector<Document>> AdmissionController::ProcessQueries(const std::vector<std::string>& queries,
+                                                                       const QueryOptions& options) {
+    std::vector<SearchServer::PreparedQuery> prepared_queries;
+    prepared_queries.reserve(queries.size());
+    size_t cost = 0;
+    size_t degraded_cost = 0;
+    for (const std::string& query : queries) {
+        prepared_queries.push_back(search_server_.PrepareQuery(query));
+        const size_t query_cost = prepared_queries.back().GetCost();
+        cost += query_cost;
+        degraded_cost += GetDegradedCost(query_cost);
+    }
+    const Ticket ticket = Admit(cost, degraded_cost);
+    const QueryBatchResults batch = search_server_.FindTopDocumentsBatch(
+            prepared_queries, ticket.GetDecision() == Decision::DEGRADED ? Degrade(options) : options);
+    std::vector<std::vector<Document>> result(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        result[i] = batch[i];
+    }
+    return result;
+}
+
+AdmissionController::Statistics AdmissionController::GetStatistics() const {
+    std::lock_guard guard(mutex_);
+    return {admitted_, degraded_, rejected_, in_flight_cost_};
+}
+
+//private:
+AdmissionController::Ticket AdmissionController::Admit(size_t cost) {
+    return Admit(cost, GetDegradedCost(cost));
+}
+
+AdmissionController::Ticket AdmissionController::Admit(size_t cost, size_t degraded_cost) {
+    std::lock_guard guard(mutex_);
+    const size_t load = in_flight_cost_ + cost;
+    const bool is_expensive = cost >= policy_.expensive_cost;
+    const auto expensive_load = static_cast<size_t>(static_cast<double>(policy_.cost_budget)
+                                                    * policy_.expensive_load_share);
+    if (in_flight_cost_ == 0 || (load <= policy_.cost_budget && (!is_expensive || load <= expensive_load))) {
+        in_flight_cost_ += cost;
+        ++admitted_;
+        return Ticket(*this, Decision::ADMITTED, cost);
+    }
+    if (in_flight_cost_ + degraded_cost <= policy_.cost_budget) {
+        in_flight_cost_ += degraded_cost;
+        ++degraded_;
+        return Ticket(*this, Decision::DEGRADED, degraded_cost);
+    }
+    ++rejected_;
+    throw QueryRejectedError(cost);
+}
+
+size_t AdmissionController::GetDegradedCost(size_t cost) const {
+    return std::min(cost, policy_.degraded_postings_budget);
+}
+
+void AdmissionController::Release(size_t cost) {
+    std::lock_guard guard(mutex_);
+    in_flight_cost_ -= cost;
+}
+
+QueryOptions AdmissionController::Degrade(const QueryOptions& options) const {
+    QueryOptions degraded = options;
+    degraded.limit = std::min(options.limit, policy_.degraded_limit);
+    degraded.impact_ordered = true;
+    degraded.postings_budget = options.postings_budget == 0
+                               ? policy_.degraded_postings_budget
+                               : std::min(options.postings_budget, policy_.degraded_postings_budget);
+    return degraded;
+}
+
+AdmissionController::Ticket::Ticket(AdmissionController& controller, Decision decision, size_t cost)
+        : controller_(controller)
+        , decision_(decision)
+        , cost_(cost) {
+}
+
+AdmissionController::Ticket::~Ticket() {
+    controller_.Release(cost_);
+}
+
+AdmissionController::Decision AdmissionController::Ticket::GetDecision() const {
+    return decision_;
+}
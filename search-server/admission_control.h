@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// запрос отклонен контролем допуска: сервер перегружен
+class QueryRejectedError : public std::runtime_error {
+public:
+    explicit QueryRejectedError(size_t cost);
+
+    [[nodiscard]] size_t GetCost() const;
+
+private:
+    size_t cost_;
+};
+
+/*
+ * Параметры контроля допуска. Стоимость запроса - SearchServer::EstimateQueryCost,
+ * бюджет ограничивает суммарную стоимость одновременно выполняемых запросов. Контроль разбирает
+ * запрос один раз (SearchServer::PrepareQuery) и выполняет уже разобранный.
+ */
+struct AdmissionPolicy {
+    size_t cost_budget = 1'000'000;
+    // запросы не дешевле этого считаются дорогими и упрощаются первыми
+    size_t expensive_cost = 100'000;
+    // дорогой запрос выполняется полностью, только пока загрузка с ним не превышает этой доли бюджета
+    double expensive_load_share = 0.5;
+    /* Упрощенный запрос вычисляется приближенно (impact_ordered с postings_budget)
+     * и возвращает не больше degraded_limit документов; его стоимость - не больше degraded_postings_budget
+     */
+    int degraded_limit = MAX_RESULT_DOCUMENT_COUNT;
+    size_t degraded_postings_budget = 10'000;
+};
+
+/*
+ * Контроль допуска перед поисковым сервером. Запрос выполняется полностью, если помещается в бюджет;
+ * иначе упрощается, а если и упрощенный не помещается - отклоняется с QueryRejectedError.
+ * Дорогие запросы упрощаются уже при загрузке выше expensive_load_share, поэтому при всплеске нагрузки
+ * первыми теряют точность они, а дешевые продолжают выполняться полностью.
+ * Запрос, пришедший, когда ничего не выполняется, не отклоняется никогда.
+ * Методы можно вызывать из нескольких потоков одновременно.
+ */
+class AdmissionController {
+public:
+    enum class Decision {
+        ADMITTED,
+        DEGRADED,
+    };
+
+    struct Statistics {
+        uint64_t admitted = 0;
+        uint64_t degraded = 0;
+        uint64_t rejected = 0;
+        // стоимость выполняемых сейчас запросов
+        size_t in_flight_cost = 0;
+    };
+
+    explicit AdmissionController(const SearchServer& search_server, const AdmissionPolicy& policy = {});
+
+    template <typename DocumentPredicate>
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                         const QueryOptions& options = {});
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                                         const QueryOptions& options = {});
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, const QueryOptions& options = {});
+    /* Пакет допускается целиком, его стоимость - сумма стоимостей запросов. Бюджет постингов
+     * упрощения действует на каждый запрос пакета, поэтому упрощенный пакет стоит
+     * сумму упрощенных стоимостей запросов
+     */
+    [[nodiscard]] std::vector<std::vector<Document>> ProcessQueries(const std::vector<std::string>& queries,
+                                                                    const QueryOptions& options = {});
+
+    [[nodiscard]] Statistics GetStatistics() const;
+
+private:
+    //стоимость запроса учитывается в бюджете, пока жив билет
+    class Ticket {
+    public:
+        Ticket(AdmissionController& controller, Decision decision, size_t cost);
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+        ~Ticket();
+
+        [[nodiscard]] Decision GetDecision() const;
+
+    private:
+        AdmissionController& controller_;
+        Decision decision_;
+        size_t cost_;
+    };
+
+    const SearchServer& search_server_;
+    AdmissionPolicy policy_;
+    mutable std::mutex mutex_;
+    size_t in_flight_cost_ = 0;
+    uint64_t admitted_ = 0;
+    uint64_t degraded_ = 0;
+    uint64_t rejected_ = 0;
+
+    /* Выбрасывает QueryRejectedError, если запрос не помещается в бюджет даже упрощенным.
+     * degraded_cost - стоимость упрощенного запроса или пакета, по умолчанию GetDegradedCost(cost)
+     */
+    Ticket Admit(size_t cost);
+    Ticket Admit(size_t cost, size_t degraded_cost);
+    // упрощенный запрос просматривает не больше degraded_postings_budget постингов
+    [[nodiscard]] size_t GetDegradedCost(size_t cost) const;
+    void Release(size_t cost);
+    [[nodiscard]] QueryOptions Degrade(const QueryOptions& options) const;
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> AdmissionController::FindTopDocuments(std::string_view raw_query,
+                                                            DocumentPredicate document_predicate,
+                                                            const QueryOptions& options) {
+    const SearchServer::PreparedQuery query = search_server_.PrepareQuery(raw_query);
+    const Ticket ticket = Admit(query.GetCost());
+    if (ticket.GetDecision() == Decision::DEGRADED) {
+        return search_server_.FindTopDocuments(query, document_predicate, Degrade(options));
+    }
+    return search_server_.FindTopDocuments(query, document_predicate, options);
+}
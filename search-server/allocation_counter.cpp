@@ -0,0 +1,209 @@
+#include "allocation_counter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+using namespace std::literals;
+
+AllocationCounts AllocationCounts::operator-(const AllocationCounts& other) const {
+    return {allocations - other.allocations, deallocations - other.deallocations, bytes - other.bytes};
+}
+
+namespace {
+
+//счетчики без динамической инициализации: operator new может быть вызван раньше любого конструктора
+thread_local AllocationCounts thread_counts;
+
+struct OperationAccumulator {
+    std::atomic<uint64_t> calls = 0;
+    std::atomic<uint64_t> allocations = 0;
+    std::atomic<uint64_t> deallocations = 0;
+    std::atomic<uint64_t> bytes = 0;
+};
+
+std::array<OperationAccumulator, ALLOCATING_OPERATION_COUNT> operation_accumulators;
+
+}  // namespace
+
+AllocationCounts AllocationCounter::ReadThread() {
+    return thread_counts;
+}
+
+void AllocationCounter::Record(AllocatingOperation operation, const AllocationCounts& delta) {
+    OperationAccumulator& accumulator = operation_accumulators[static_cast<size_t>(operation)];
+    accumulator.calls.fetch_add(1, std::memory_order_relaxed);
+    accumulator.allocations.fetch_add(delta.allocations, std::memory_order_relaxed);
+    accumulator.deallocations.fetch_add(delta.deallocations, std::memory_order_relaxed);
+    accumulator.bytes.fetch_add(delta.bytes, std::memory_order_relaxed);
+}
+
+AllocationCounter::Report AllocationCounter::GetReport() {
+    Report report;
+    for (size_t operation = 0; operation < ALLOCATING_OPERATION_COUNT; ++operation) {
+        const OperationAccumulator& accumulator = operation_accumulators[operation];
+        report[operation].calls = accumulator.calls.load(std::memory_order_relaxed);
+        report[operation].counts = {accumulator.allocations.load(std::memory_order_relaxed),
+                                    accumulator.deallocations.load(std::memory_order_relaxed),
+                                    accumulator.bytes.load(std::memory_order_relaxed)};
+    }
+    return report;
+}
+
+void AllocationCounter::Reset() {
+    for (OperationAccumulator& accumulator : operation_accumulators) {
+        accumulator.calls.store(0, std::memory_order_relaxed);
+        accumulator.allocations.store(0, std::memory_order_relaxed);
+        accumulator.deallocations.store(0, std::memory_order_relaxed);
+        accumulator.bytes.store(0, std::memory_order_relaxed);
+    }
+}
+
+void AllocationCounter::PrintReport(std::ostream& output) {
+    const Report report = GetReport();
+    output << std::left << std::setw(20) << "operation"sv << std::right << std::setw(10) << "calls"sv
+           << std::setw(16) << "allocs/call"sv << std::setw(16) << "bytes/call"sv << '\n';
+    for (size_t operation = 0; operation < ALLOCATING_OPERATION_COUNT; ++operation) {
+        const OperationReport& operation_report = report[operation];
+        const auto per_call = [&operation_report](uint64_t value) {
+            return operation_report.calls == 0 ? 0.0
+                                               : static_cast<double>(value) / static_cast<double>(operation_report.calls);
+        };
+        output << std::left << std::setw(20) << GetOperationName(static_cast<AllocatingOperation>(operation))
+               << std::right << std::setw(10) << operation_report.calls << std::fixed << std::setprecision(1)
+               << std::setw(16) << per_call(operation_report.counts.allocations)
+               << std::setw(16) << per_call(operation_report.counts.bytes) << '\n';
+        output.unsetf(std::ios_base::floatfield);
+    }
+}
+
+std::string_view AllocationCounter::GetOperationName(AllocatingOperation operation) {
+    switch (operation) {
+        case AllocatingOperation::ADD_DOCUMENT:
+            return "AddDocument"sv;
+        case AllocatingOperation::FIND_TOP_DOCUMENTS:
+            return "FindTopDocuments"sv;
+        case AllocatingOperation::MATCH_DOCUMENT:
+            return "MatchDocument"sv;
+        case AllocatingOperation::REMOVE_DOCUMENT:
+            return "RemoveDocument"sv;
+    }
+    return "unknown"sv;
+}
+
+#if SEARCH_SERVER_COUNT_ALLOCATIONS
+
+namespace {
+
+void* CountedAllocate(std::size_t size) noexcept {
+    ++thread_counts.allocations;
+    thread_counts.bytes += size;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* CountedAllocateAligned(std::size_t size, std::align_val_t alignment) noexcept {
+    ++thread_counts.allocations;
+    thread_counts.bytes += size;
+    const auto align = static_cast<std::size_t>(alignment);
+    //размер для aligned_alloc должен быть кратен выравниванию
+    return std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align);
+}
+
+void CountedFree(void* pointer) noexcept {
+    if (pointer != nullptr) {
+        ++thread_counts.deallocations;
+        std::free(pointer);
+    }
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+    if (void* pointer = CountedAllocate(size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return CountedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return CountedAllocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (void* pointer = CountedAllocateAligned(size, alignment)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return CountedAllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return CountedAllocateAligned(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    CountedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    CountedFree(pointer);
+}
+
+#endif
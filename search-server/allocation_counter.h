@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+#include "instrumentation.h"
+
+/*
+ * Учет выделений памяти для бенчмарков и диагностики. Сборка всей программы
+ * с -DSEARCH_SERVER_COUNT_ALLOCATIONS=1 заменяет глобальные operator new и operator delete
+ * считающими версиями; по умолчанию замены нет, а ALLOCATION_SCOPE раскрывается в пустоту.
+ */
+#ifndef SEARCH_SERVER_COUNT_ALLOCATIONS
+#define SEARCH_SERVER_COUNT_ALLOCATIONS 0
+#endif
+
+// операции сервера, для которых ведется учет выделений
+enum class AllocatingOperation {
+    ADD_DOCUMENT,
+    FIND_TOP_DOCUMENTS,
+    MATCH_DOCUMENT,
+    REMOVE_DOCUMENT,
+};
+
+inline constexpr size_t ALLOCATING_OPERATION_COUNT = 4;
+
+struct AllocationCounts {
+    uint64_t allocations = 0;
+    uint64_t deallocations = 0;
+    uint64_t bytes = 0;  // запрошено байт при выделениях
+
+    AllocationCounts operator-(const AllocationCounts& other) const;
+};
+
+/*
+ * Счетчики выделений. Каждый поток считает свои выделения, поэтому разность ReadThread
+ * до и после вызова - выделения этого вызова, кроме сделанных в других потоках
+ * (параллельные политики, пул потоков).
+ */
+class AllocationCounter {
+public:
+    struct OperationReport {
+        uint64_t calls = 0;
+        AllocationCounts counts;
+    };
+    using Report = std::array<OperationReport, ALLOCATING_OPERATION_COUNT>;
+
+    [[nodiscard]] static constexpr bool IsEnabled() {
+        return SEARCH_SERVER_COUNT_ALLOCATIONS != 0;
+    }
+
+    [[nodiscard]] static AllocationCounts ReadThread();
+
+    static void Record(AllocatingOperation operation, const AllocationCounts& delta);
+    [[nodiscard]] static Report GetReport();
+    static void Reset();
+    // таблица по операциям: вызовы, выделения и байты на вызов
+    static void PrintReport(std::ostream& output);
+
+    [[nodiscard]] static std::string_view GetOperationName(AllocatingOperation operation);
+};
+
+// записывает в AllocationCounter выделения текущего потока от создания до конца блока
+class AllocationScope {
+public:
+    explicit AllocationScope(AllocatingOperation operation)
+            : operation_(operation)
+            , start_(AllocationCounter::ReadThread()) {
+    }
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+    ~AllocationScope() {
+        AllocationCounter::Record(operation_, AllocationCounter::ReadThread() - start_);
+    }
+
+private:
+    AllocatingOperation operation_;
+    AllocationCounts start_;
+};
+
+#if SEARCH_SERVER_COUNT_ALLOCATIONS
+#define ALLOCATION_SCOPE(operation) AllocationScope PROFILE_CONCAT(allocationScope, __LINE__)(operation)
+#else
+#define ALLOCATION_SCOPE(operation)
+#endif
@@ -0,0 +1,96 @@
+#include "async_executor.h"
+
+#include <algorithm>
+
+namespace {
+
+//исполнитель, в потоке которого выполняется текущая задача
+thread_local const AsyncExecutor* current_executor = nullptr;
+
+}  // namespace
+
+AsyncExecutor::AsyncExecutor(size_t worker_count, size_t queue_capacity)
+        : queue_capacity_(std::max<size_t>(queue_capacity, 1)) {
+    worker_count = std::max<size_t>(worker_count, 1);
+    workers_.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers_.emplace_back([this] {
+            RunWorker();
+        });
+    }
+}
+
+AsyncExecutor::~AsyncExecutor() {
+    {
+        std::lock_guard guard(mutex_);
+        stop_ = true;
+    }
+    not_empty_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void AsyncExecutor::Post(std::function<void()> task) {
+    PushTask(task, true);
+}
+
+bool AsyncExecutor::TryPost(std::function<void()> task) {
+    return PushTask(task, false);
+}
+
+size_t AsyncExecutor::GetWorkerCount() const {
+    return workers_.size();
+}
+
+size_t AsyncExecutor::GetQueueCapacity() const {
+    return queue_capacity_;
+}
+
+size_t AsyncExecutor::GetQueueSize() const {
+    std::lock_guard guard(mutex_);
+    return tasks_.size();
+}
+
+std::unique_ptr<AsyncExecutor> AsyncExecutor::CloneEmpty() const {
+    return std::make_unique<AsyncExecutor>(workers_.size(), queue_capacity_);
+}
+
+bool AsyncExecutor::PushTask(std::function<void()>& task, bool wait) {
+    {
+        std::unique_lock lock(mutex_);
+        if (current_executor != this) {
+            const auto has_room = [this] {
+                return tasks_.size() < queue_capacity_;
+            };
+            if (wait) {
+                not_full_.wait(lock, has_room);
+            } else if (!has_room()) {
+                return false;
+            }
+        }
+        tasks_.push_back(std::move(task));
+    }
+    not_empty_.notify_one();
+    return true;
+}
+
+void AsyncExecutor::RunWorker() {
+    current_executor = this;
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex_);
+            not_empty_.wait(lock, [this] {
+                return stop_ || !tasks_.empty();
+            });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        not_full_.notify_one();
+        task();
+    }
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>
+#define SEARCH_SERVER_HAS_COROUTINES 1
+#endif
+
+/*
+ * Исполнитель асинхронных запросов: фиксированное число потоков и очередь ограниченной длины.
+ * Когда очередь заполнена, постановка задачи ждет освобождения места - так вызывающий
+ * не может набрать больше запросов, чем исполнитель успевает обработать.
+ * Задачи, которые ставят сами потоки исполнителя (продолжения корутин, вложенные Submit),
+ * ставятся без ожидания: поток, ждущий места в очереди, не разбирает ее, и когда так ждут
+ * все потоки, исполнитель зависает. Поэтому очередь может ненадолго превысить свою длину.
+ * TryPost и TrySubmit не ждут: при заполненной очереди задача не ставится.
+ * Деструктор выполняет уже поставленные задачи и останавливает потоки.
+ */
+class AsyncExecutor {
+public:
+    AsyncExecutor(size_t worker_count, size_t queue_capacity);
+    ~AsyncExecutor();
+
+    AsyncExecutor(const AsyncExecutor&) = delete;
+    AsyncExecutor& operator=(const AsyncExecutor&) = delete;
+
+    void Post(std::function<void()> task);
+    // false, если очередь заполнена; задача тогда не поставлена
+    [[nodiscard]] bool TryPost(std::function<void()> task);
+
+    // выполняет func() в потоке исполнителя; результат или исключение - в возвращаемом future
+    template <typename Func>
+    std::future<std::invoke_result_t<Func>> Submit(Func func);
+    // пустой optional, если очередь заполнена
+    template <typename Func>
+    std::optional<std::future<std::invoke_result_t<Func>>> TrySubmit(Func func);
+
+    [[nodiscard]] size_t GetWorkerCount() const;
+    [[nodiscard]] size_t GetQueueCapacity() const;
+    // число задач, ожидающих потока
+    [[nodiscard]] size_t GetQueueSize() const;
+    // исполнитель с теми же настройками и пустой очередью
+    [[nodiscard]] std::unique_ptr<AsyncExecutor> CloneEmpty() const;
+
+private:
+    size_t queue_capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<std::function<void()>> tasks_;
+    bool stop_ = false;
+    std::vector<std::thread> workers_;
+
+    bool PushTask(std::function<void()>& task, bool wait);
+    void RunWorker();
+};
+
+template <typename Func>
+std::future<std::invoke_result_t<Func>> AsyncExecutor::Submit(Func func) {
+    //std::function требует копируемой задачи, а packaged_task только перемещается
+    auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Func>()>>(std::move(func));
+    auto future = task->get_future();
+    Post([task] {
+        (*task)();
+    });
+    return future;
+}
+
+template <typename Func>
+std::optional<std::future<std::invoke_result_t<Func>>> AsyncExecutor::TrySubmit(Func func) {
+    auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Func>()>>(std::move(func));
+    auto future = task->get_future();
+    if (!TryPost([task] {
+            (*task)();
+        })) {
+        return std::nullopt;
+    }
+    return future;
+}
+
+#if defined(SEARCH_SERVER_HAS_COROUTINES)
+/*
+ * Ожидаемый объект для корутин C++20: co_await выполняет функцию в потоке исполнителя
+ * и возобновляет корутину в том же потоке. Исключение функции выбрасывается из co_await.
+ * Следующий co_await из возобновленной корутины ставит задачу из потока исполнителя
+ * и поэтому не ждет места в очереди.
+ */
+template <typename Result>
+class AsyncCall {
+public:
+    AsyncCall(AsyncExecutor& executor, std::function<Result()> func)
+            : executor_(executor)
+            , func_(std::move(func)) {
+    }
+
+    [[nodiscard]] bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        executor_.Post([this, handle] {
+            try {
+                result_.emplace(func_());
+            } catch (...) {
+                error_ = std::current_exception();
+            }
+            handle.resume();
+        });
+    }
+
+    Result await_resume() {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        return std::move(*result_);
+    }
+
+private:
+    AsyncExecutor& executor_;
+    std::function<Result()> func_;
+    std::optional<Result> result_;
+    std::exception_ptr error_;
+};
+#endif
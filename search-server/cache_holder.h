@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+/*
+ * Кеш (или другое состояние, привязанное к конкретному поисковому серверу), по умолчанию выключен.
+ * Копия сервера получает собственный пустой кеш с теми же настройками: поколения индекса у копий
+ * расходятся, и общий кеш отдавал бы результаты чужого индекса.
+ * Cache должен уметь создавать пустую копию: std::unique_ptr<Cache> CloneEmpty() const.
+ */
+template <typename Cache>
+class CacheHolder {
+public:
+    CacheHolder() = default;
+
+    CacheHolder(const CacheHolder& other)
+            : cache_(other.cache_ ? other.cache_->CloneEmpty() : nullptr) {
+    }
+
+    CacheHolder& operator=(const CacheHolder& other) {
+        if (this != &other) {
+            cache_ = other.cache_ ? other.cache_->CloneEmpty() : nullptr;
+        }
+        return *this;
+    }
+
+    template <typename... Args>
+    void Enable(Args&&... args) {
+        cache_ = std::make_unique<Cache>(std::forward<Args>(args)...);
+    }
+
+    void Disable() {
+        cache_.reset();
+    }
+
+    // nullptr, если кеш выключен
+    [[nodiscard]] Cache* Get() const {
+        return cache_.get();
+    }
+
+private:
+    std::unique_ptr<Cache> cache_;
+};
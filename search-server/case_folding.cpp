@@ -0,0 +1,251 @@
+#include "case_folding.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+struct FoldRange {
+    char32_t first;
+    char32_t last;
+    int32_t delta;
+    // только символы той же четности, что и first: в диапазоне чередуются прописные и строчные
+    bool every_other;
+};
+
+//по возрастанию; символ и его строчная форма кодируются в UTF-8 одинаковым числом байтов
+constexpr FoldRange FOLD_RANGES[] = {
+        {0x00C0, 0x00D6, 0x20, false},  // À-Ö
+        {0x00D8, 0x00DE, 0x20, false},  // Ø-Þ
+        {0x0100, 0x012F, 0x01, true},   // Ā-į
+        {0x0132, 0x0137, 0x01, true},   // Ĳ-ķ
+        {0x0139, 0x0148, 0x01, true},   // Ĺ-ň
+        {0x014A, 0x0177, 0x01, true},   // Ŋ-ŷ
+        {0x0178, 0x0178, 0x00FF - 0x0178, false},  // Ÿ
+        {0x0179, 0x017E, 0x01, true},   // Ź-ž
+        {0x0386, 0x0386, 0x26, false},  // Ά
+        {0x0388, 0x038A, 0x25, false},  // Έ-Ί
+        {0x038C, 0x038C, 0x40, false},  // Ό
+        {0x038E, 0x038F, 0x3F, false},  // Ύ-Ώ
+        {0x0391, 0x03A1, 0x20, false},  // Α-Ρ
+        {0x03A3, 0x03AB, 0x20, false},  // Σ-Ϋ
+        {0x0400, 0x040F, 0x50, false},  // Ѐ-Џ
+        {0x0410, 0x042F, 0x20, false},  // А-Я
+        {0x0460, 0x0481, 0x01, true},   // Ѡ-ҁ
+        {0x048A, 0x04BF, 0x01, true},   // Ҋ-ҿ
+        {0x04C0, 0x04C0, 0x0F, false},  // Ӏ
+        {0x04C1, 0x04CE, 0x01, true},   // Ӂ-ӎ
+        {0x04D0, 0x052F, 0x01, true},   // Ӑ-ԯ
+        {0x0531, 0x0556, 0x30, false},  // Ա-Ֆ
+        //далее трехбайтовые символы
+        {0x10A0, 0x10C5, 0x2D00 - 0x10A0, false},  // Ⴀ-Ⴥ (грузинский асомтаврули)
+        {0x10C7, 0x10C7, 0x2D27 - 0x10C7, false},  // Ⴧ
+        {0x10CD, 0x10CD, 0x2D2D - 0x10CD, false},  // Ⴭ
+        {0x1C90, 0x1CBA, 0x10D0 - 0x1C90, false},  // Ა-Ჺ (грузинский мтаврули)
+        {0x1CBD, 0x1CBF, 0x10FD - 0x1CBD, false},  // Ჽ-Ჿ
+        {0x1E00, 0x1E95, 0x01, true},   // Ḁ-ẕ
+        {0x1EA0, 0x1EFF, 0x01, true},   // Ạ-ỿ
+        {0x1F08, 0x1F0F, -0x08, false},  // Ἀ-Ἇ
+        {0x1F18, 0x1F1D, -0x08, false},  // Ἐ-Ἕ
+        {0x1F28, 0x1F2F, -0x08, false},  // Ἠ-Ἧ
+        {0x1F38, 0x1F3F, -0x08, false},  // Ἰ-Ἷ
+        {0x1F48, 0x1F4D, -0x08, false},  // Ὀ-Ὅ
+        {0x1F59, 0x1F5F, -0x08, true},   // Ὑ-Ὗ
+        {0x1F68, 0x1F6F, -0x08, false},  // Ὠ-Ὧ
+        {0x1F88, 0x1F8F, -0x08, false},  // ᾈ-ᾏ
+        {0x1F98, 0x1F9F, -0x08, false},  // ᾘ-ᾟ
+        {0x1FA8, 0x1FAF, -0x08, false},  // ᾨ-ᾯ
+        {0x1FB8, 0x1FB9, -0x08, false},  // Ᾰ-Ᾱ
+        {0x1FBA, 0x1FBB, 0x1F70 - 0x1FBA, false},  // Ὰ-Ά
+        {0x1FBC, 0x1FBC, 0x1FB3 - 0x1FBC, false},  // ᾼ
+        {0x1FC8, 0x1FCB, 0x1F72 - 0x1FC8, false},  // Ὲ-Ή
+        {0x1FCC, 0x1FCC, 0x1FC3 - 0x1FCC, false},  // ῌ
+        {0x1FD8, 0x1FD9, -0x08, false},  // Ῐ-Ῑ
+        {0x1FDA, 0x1FDB, 0x1F76 - 0x1FDA, false},  // Ὶ-Ί
+        {0x1FE8, 0x1FE9, -0x08, false},  // Ῠ-Ῡ
+        {0x1FEA, 0x1FEB, 0x1F7A - 0x1FEA, false},  // Ὺ-Ύ
+        {0x1FEC, 0x1FEC, 0x1FE5 - 0x1FEC, false},  // Ῥ
+        {0x1FF8, 0x1FF9, 0x1F78 - 0x1FF8, false},  // Ὸ-Ό
+        {0x1FFA, 0x1FFB, 0x1F7C - 0x1FFA, false},  // Ὼ-Ώ
+        {0x1FFC, 0x1FFC, 0x1FF3 - 0x1FFC, false},  // ῼ
+        {0xFF21, 0xFF3A, 0x20, false},  // Ａ-Ｚ (полноширинная латиница)
+};
+
+char32_t FoldCodePoint(char32_t code_point) {
+    const auto it = std::lower_bound(std::begin(FOLD_RANGES), std::end(FOLD_RANGES), code_point,
+                                     [](const FoldRange& range, char32_t value) {
+                                         return range.last < value;
+                                     });
+    if (it == std::end(FOLD_RANGES) || code_point < it->first) {
+        return code_point;
+    }
+    if (it->every_other && (code_point - it->first) % 2 != 0) {
+        return code_point;
+    }
+    return static_cast<char32_t>(static_cast<int32_t>(code_point) + it->delta);
+}
+
+constexpr uint64_t ONES = 0x0101010101010101ULL;
+
+// старшие биты байтов 'A'-'Z' среди восьми байтов ASCII: b + 0x3F переходит через 0x80 при b >= 'A', b + 0x25 - при b > 'Z'
+uint64_t AsciiUpperMask(uint64_t chunk) {
+    return (chunk + 0x3F * ONES) & ~(chunk + 0x25 * ONES) & (0x80 * ONES);
+}
+
+// складывает двухбайтовую последовательность; false, если символ не меняется
+bool FoldTwoBytes(unsigned char& lead, unsigned char& trail) {
+    //кириллица Ѐ-Я складывается без декодирования
+    if (lead == 0xD0) {
+        if (trail >= 0x90 && trail <= 0x9F) {
+            trail += 0x20;
+            return true;
+        }
+        if (trail >= 0xA0 && trail <= 0xAF) {
+            lead = 0xD1;
+            trail -= 0x20;
+            return true;
+        }
+        if (trail <= 0x8F) {
+            lead = 0xD1;
+            trail += 0x10;
+            return true;
+        }
+        return false;
+    }
+    const char32_t code_point = (static_cast<char32_t>(lead & 0x1F) << 6) | (trail & 0x3F);
+    const char32_t folded = FoldCodePoint(code_point);
+    if (folded == code_point) {
+        return false;
+    }
+    lead = static_cast<unsigned char>(0xC0 | (folded >> 6));
+    trail = static_cast<unsigned char>(0x80 | (folded & 0x3F));
+    return true;
+}
+
+// складывает трехбайтовую последовательность; false, если символ не меняется
+bool FoldThreeBytes(unsigned char& lead, unsigned char& middle, unsigned char& trail) {
+    const char32_t code_point = (static_cast<char32_t>(lead & 0x0F) << 12)
+                                | (static_cast<char32_t>(middle & 0x3F) << 6) | (trail & 0x3F);
+    const char32_t folded = FoldCodePoint(code_point);
+    if (folded == code_point) {
+        return false;
+    }
+    lead = static_cast<unsigned char>(0xE0 | (folded >> 12));
+    middle = static_cast<unsigned char>(0x80 | ((folded >> 6) & 0x3F));
+    trail = static_cast<unsigned char>(0x80 | (folded & 0x3F));
+    return true;
+}
+
+bool IsContinuation(unsigned char byte) {
+    return (byte & 0xC0) == 0x80;
+}
+
+/*
+ * Длина корректной последовательности UTF-8 из первых size байтов data; 0, если последовательность
+ * некорректна: недопустимый первый байт, нехватка байтов продолжения, избыточная запись или суррогат
+ */
+size_t ValidSequenceLength(const unsigned char* data, size_t size) {
+    const unsigned char lead = data[0];
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        return size >= 2 && IsContinuation(data[1]) ? 2 : 0;
+    }
+    if (lead >= 0xE0 && lead <= 0xEF) {
+        if (size < 3 || !IsContinuation(data[1]) || !IsContinuation(data[2])) {
+            return 0;
+        }
+        //E0 80-9F - избыточная запись, ED A0-BF - суррогаты
+        if ((lead == 0xE0 && data[1] < 0xA0) || (lead == 0xED && data[1] > 0x9F)) {
+            return 0;
+        }
+        return 3;
+    }
+    if (lead >= 0xF0 && lead <= 0xF4) {
+        if (size < 4 || !IsContinuation(data[1]) || !IsContinuation(data[2]) || !IsContinuation(data[3])) {
+            return 0;
+        }
+        //F0 80-8F - избыточная запись, F4 90-BF - за пределами U+10FFFF
+        if ((lead == 0xF0 && data[1] < 0x90) || (lead == 0xF4 && data[1] > 0x8F)) {
+            return 0;
+        }
+        return 4;
+    }
+    return 0;
+}
+
+/*
+ * Проходит text начиная с pos. Если out == nullptr, возвращает позицию первого байта, который изменится
+ * при сложении, либо text.size(). Иначе записывает измененные байты в out (копию text) и возвращает text.size().
+ */
+size_t FoldFrom(std::string_view text, size_t pos, char* out) {
+    const auto* data = reinterpret_cast<const unsigned char*>(text.data());
+    while (pos < text.size()) {
+        if (pos + sizeof(uint64_t) <= text.size()) {
+            uint64_t chunk;
+            std::memcpy(&chunk, data + pos, sizeof(chunk));
+            if ((chunk & (0x80 * ONES)) == 0) {
+                const uint64_t upper = AsciiUpperMask(chunk);
+                if (upper != 0) {
+                    if (out == nullptr) {
+                        return pos;
+                    }
+                    //0x80 >> 2 == 0x20 - разница между прописной и строчной буквой
+                    chunk |= upper >> 2;
+                    std::memcpy(out + pos, &chunk, sizeof(chunk));
+                }
+                pos += sizeof(uint64_t);
+                continue;
+            }
+        }
+        const unsigned char byte = data[pos];
+        if (byte < 0x80) {
+            if (byte >= 'A' && byte <= 'Z') {
+                if (out == nullptr) {
+                    return pos;
+                }
+                out[pos] = static_cast<char>(byte + ('a' - 'A'));
+            }
+            ++pos;
+            continue;
+        }
+        const size_t length = ValidSequenceLength(data + pos, text.size() - pos);
+        if (length == 2) {
+            unsigned char lead = byte;
+            unsigned char trail = data[pos + 1];
+            if (FoldTwoBytes(lead, trail)) {
+                if (out == nullptr) {
+                    return pos;
+                }
+                out[pos] = static_cast<char>(lead);
+                out[pos + 1] = static_cast<char>(trail);
+            }
+        } else if (length == 3) {
+            unsigned char lead = byte;
+            unsigned char middle = data[pos + 1];
+            unsigned char trail = data[pos + 2];
+            if (FoldThreeBytes(lead, middle, trail)) {
+                if (out == nullptr) {
+                    return pos;
+                }
+                out[pos] = static_cast<char>(lead);
+                out[pos + 1] = static_cast<char>(middle);
+                out[pos + 2] = static_cast<char>(trail);
+            }
+        }
+        //четырехбайтовые символы в таблице не встречаются, а некорректные байты пропускаем по одному
+        pos += std::max<size_t>(length, 1);
+    }
+    return text.size();
+}
+
+}  // namespace
+
+std::string_view FoldCase(std::string_view text, std::string& storage) {
+    const size_t first = FoldFrom(text, 0, nullptr);
+    if (first == text.size()) {
+        return text;
+    }
+    storage.assign(text);
+    FoldFrom(text, first, storage.data());
+    return storage;
+}
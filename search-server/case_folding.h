@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/*
+ * Приведение текста UTF-8 к нижнему регистру. Латиница и кириллица складываются без обращения
+ * к таблицам (ASCII - по восемь байт за шаг), остальные буквы - по таблице диапазонов для латинских
+ * расширений (включая дополнительную латиницу U+1E00-1EFF и полноширинную), греческого с расширенным,
+ * кириллических дополнений, армянского и грузинского. Все отображения сохраняют длину в байтах;
+ * буквы, у которых строчная форма длиннее или неоднозначна (например, турецкая İ или ẞ), и символы
+ * за пределами таблицы, в том числе все четырехбайтовые, остаются как есть.
+ * Некорректные последовательности UTF-8 не меняются и пропускаются по байту.
+ *
+ * Возвращает text, если в нем нечего менять, иначе сложенный текст, записанный в storage.
+ */
+std::string_view FoldCase(std::string_view text, std::string& storage);
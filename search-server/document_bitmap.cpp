@@ -0,0 +1,206 @@
+#include "document_bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+void DocumentBitmap::Add(int document_id) {
+    const auto id = static_cast<uint32_t>(document_id);
+    const auto key = static_cast<uint16_t>(id >> 16);
+    //id обычно добавляются по возрастанию, поэтому сначала проверяем последний контейнер
+    Container new_container;
+    new_container.key = key;
+    auto it = containers_.end();
+    if (containers_.empty() || containers_.back().key < key) {
+        it = containers_.insert(containers_.end(), std::move(new_container));
+    } else if (containers_.back().key == key) {
+        it = containers_.end() - 1;
+    } else {
+        it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                              [](const Container& container, uint16_t value) { return container.key < value; });
+        if (it == containers_.end() || it->key != key) {
+            it = containers_.insert(it, std::move(new_container));
+        }
+    }
+    if (it->Add(static_cast<uint16_t>(id & 0xFFFF))) {
+        ++size_;
+    }
+}
+
+void DocumentBitmap::Remove(int document_id) {
+    const auto id = static_cast<uint32_t>(document_id);
+    const auto key = static_cast<uint16_t>(id >> 16);
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                               [](const Container& container, uint16_t value) { return container.key < value; });
+    if (it == containers_.end() || it->key != key) {
+        return;
+    }
+    if (it->Remove(static_cast<uint16_t>(id & 0xFFFF))) {
+        --size_;
+        if (it->cardinality == 0) {
+            containers_.erase(it);
+        }
+    }
+}
+
+bool DocumentBitmap::Contains(int document_id) const {
+    const auto id = static_cast<uint32_t>(document_id);
+    const Container* container = FindContainer(static_cast<uint16_t>(id >> 16));
+    return container != nullptr && container->Contains(static_cast<uint16_t>(id & 0xFFFF));
+}
+
+size_t DocumentBitmap::Size() const {
+    return size_;
+}
+
+bool DocumentBitmap::Empty() const {
+    return size_ == 0;
+}
+
+size_t DocumentBitmap::GetMemoryUsage() const {
+    size_t bytes = containers_.capacity() * sizeof(Container);
+    for (const Container& container : containers_) {
+        bytes += container.array.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+DocumentBitmap& DocumentBitmap::operator|=(const DocumentBitmap& other) {
+    //контейнеры перемещаются в merged, поэтому объединение с собой обрабатывается отдельно
+    if (this == &other) {
+        return *this;
+    }
+    std::vector<Container> merged;
+    merged.reserve(containers_.size() + other.containers_.size());
+    auto it = containers_.begin();
+    auto other_it = other.containers_.begin();
+    size_ = 0;
+    while (it != containers_.end() || other_it != other.containers_.end()) {
+        if (other_it == other.containers_.end() || (it != containers_.end() && it->key < other_it->key)) {
+            merged.push_back(std::move(*it++));
+        } else if (it == containers_.end() || other_it->key < it->key) {
+            merged.push_back(*other_it++);
+        } else {
+            Container container = std::move(*it++);
+            const Container& addition = *other_it++;
+            if (!container.IsBitset() && !addition.IsBitset()
+                && container.cardinality + addition.cardinality <= ARRAY_LIMIT) {
+                std::vector<uint16_t> values;
+                values.reserve(container.cardinality + addition.cardinality);
+                std::set_union(container.array.begin(), container.array.end(),
+                               addition.array.begin(), addition.array.end(), std::back_inserter(values));
+                container.array = std::move(values);
+                container.cardinality = container.array.size();
+            } else {
+                container.ConvertToBitset();
+                if (addition.IsBitset()) {
+                    for (size_t i = 0; i < BITSET_WORDS; ++i) {
+                        container.bits[i] |= addition.bits[i];
+                    }
+                } else {
+                    for (const uint16_t value : addition.array) {
+                        container.bits[value >> 6] |= uint64_t{1} << (value & 63);
+                    }
+                }
+                container.cardinality = 0;
+                for (const uint64_t word : container.bits) {
+                    container.cardinality += __builtin_popcountll(word);
+                }
+            }
+            merged.push_back(std::move(container));
+        }
+        size_ += merged.back().cardinality;
+    }
+    containers_ = std::move(merged);
+    return *this;
+}
+
+const DocumentBitmap::Container* DocumentBitmap::FindContainer(uint16_t key) const {
+    //в типичном корпусе id плотные и контейнер один-два, поэтому сначала сравниваем с первым
+    if (!containers_.empty() && containers_.front().key == key) {
+        return &containers_.front();
+    }
+    const auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                                     [](const Container& container, uint16_t value) { return container.key < value; });
+    return (it == containers_.end() || it->key != key) ? nullptr : &*it;
+}
+
+bool DocumentBitmap::Container::IsBitset() const {
+    return !bits.empty();
+}
+
+bool DocumentBitmap::Container::Contains(uint16_t low) const {
+    if (IsBitset()) {
+        return (bits[low >> 6] >> (low & 63)) & 1;
+    }
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+bool DocumentBitmap::Container::Add(uint16_t low) {
+    if (IsBitset()) {
+        uint64_t& word = bits[low >> 6];
+        const uint64_t mask = uint64_t{1} << (low & 63);
+        if (word & mask) {
+            return false;
+        }
+        word |= mask;
+        ++cardinality;
+        return true;
+    }
+    auto it = array.end();
+    if (!array.empty() && array.back() >= low) {
+        it = std::lower_bound(array.begin(), array.end(), low);
+        if (*it == low) {
+            return false;
+        }
+    }
+    array.insert(it, low);
+    ++cardinality;
+    //массив разросся - переходим на битовую карту
+    if (cardinality > ARRAY_LIMIT) {
+        ConvertToBitset();
+    }
+    return true;
+}
+
+void DocumentBitmap::Container::ConvertToBitset() {
+    if (IsBitset()) {
+        return;
+    }
+    bits.assign(BITSET_WORDS, 0);
+    for (const uint16_t value : array) {
+        bits[value >> 6] |= uint64_t{1} << (value & 63);
+    }
+    array.clear();
+    array.shrink_to_fit();
+}
+
+bool DocumentBitmap::Container::Remove(uint16_t low) {
+    if (IsBitset()) {
+        uint64_t& word = bits[low >> 6];
+        const uint64_t mask = uint64_t{1} << (low & 63);
+        if (!(word & mask)) {
+            return false;
+        }
+        word &= ~mask;
+        --cardinality;
+        //возвращаемся к массиву с запасом, чтобы не переключаться туда-обратно на границе
+        if (cardinality <= ARRAY_LIMIT / 2) {
+            array.reserve(cardinality);
+            for (size_t i = 0; i < BITSET_WORDS; ++i) {
+                for (uint64_t rest = bits[i]; rest != 0; rest &= rest - 1) {
+                    array.push_back(static_cast<uint16_t>(i * 64 + __builtin_ctzll(rest)));
+                }
+            }
+            bits.clear();
+            bits.shrink_to_fit();
+        }
+        return true;
+    }
+    const auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (it == array.end() || *it != low) {
+        return false;
+    }
+    array.erase(it);
+    --cardinality;
+    return true;
+}
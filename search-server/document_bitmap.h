@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Сжатое множество id документов в духе roaring bitmap.
+ * Id делится на старшие и младшие 16 бит; документы с общими старшими битами хранятся в одном
+ * контейнере: пока их немного - отсортированным массивом младших половин, иначе - битовой картой на 2^16 бит.
+ * Отрицательные id не поддерживаются: в поисковом сервере id документов неотрицательны.
+ */
+class DocumentBitmap {
+public:
+    void Add(int document_id);
+    void Remove(int document_id);
+    [[nodiscard]] bool Contains(int document_id) const;
+
+    [[nodiscard]] size_t Size() const;
+    [[nodiscard]] bool Empty() const;
+    // байт, занятых контейнерами, без учета самого объекта
+    [[nodiscard]] size_t GetMemoryUsage() const;
+
+    // объединение с другим множеством
+    DocumentBitmap& operator|=(const DocumentBitmap& other);
+
+private:
+    static constexpr size_t ARRAY_LIMIT = 4096;
+    static constexpr size_t BITSET_WORDS = (1 << 16) / 64;
+
+    struct Container {
+        uint16_t key = 0;
+        size_t cardinality = 0;
+        std::vector<uint16_t> array;  // используется, пока cardinality <= ARRAY_LIMIT
+        std::vector<uint64_t> bits;   // иначе битовая карта из BITSET_WORDS слов
+
+        [[nodiscard]] bool IsBitset() const;
+        void ConvertToBitset();
+        [[nodiscard]] bool Contains(uint16_t low) const;
+        bool Add(uint16_t low);
+        bool Remove(uint16_t low);
+    };
+
+    std::vector<Container> containers_;  // по возрастанию key
+    size_t size_ = 0;
+
+    [[nodiscard]] const Container* FindContainer(uint16_t key) const;
+};
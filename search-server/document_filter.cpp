@@ -0,0 +1,337 @@
+#include "document_filter.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace std::string_literals;
+
+DocumentFilter::DocumentFilter(Kind kind)
+        : kind_(kind) {
+}
+
+DocumentFilter DocumentFilter::Status(std::set<DocumentStatus> statuses) {
+    DocumentFilter filter(Kind::STATUS);
+    filter.statuses_ = std::move(statuses);
+    return filter;
+}
+
+DocumentFilter DocumentFilter::RatingRange(int min_rating, int max_rating) {
+    DocumentFilter filter(Kind::RATING_RANGE);
+    filter.min_ = min_rating;
+    filter.max_ = max_rating;
+    return filter;
+}
+
+DocumentFilter DocumentFilter::IdRange(int min_id, int max_id) {
+    DocumentFilter filter(Kind::ID_RANGE);
+    filter.min_ = min_id;
+    filter.max_ = max_id;
+    return filter;
+}
+
+DocumentFilter DocumentFilter::IdIn(std::vector<int> document_ids) {
+    DocumentFilter filter(Kind::ID_IN);
+    std::sort(document_ids.begin(), document_ids.end());
+    document_ids.erase(std::unique(document_ids.begin(), document_ids.end()), document_ids.end());
+    filter.document_ids_ = std::move(document_ids);
+    return filter;
+}
+
+DocumentFilter DocumentFilter::IdNotIn(std::vector<int> document_ids) {
+    DocumentFilter filter = IdIn(std::move(document_ids));
+    filter.kind_ = Kind::ID_NOT_IN;
+    return filter;
+}
+
+DocumentFilter DocumentFilter::AllOf(std::vector<DocumentFilter> filters) {
+    DocumentFilter filter(Kind::ALL_OF);
+    filter.children_ = std::move(filters);
+    return filter;
+}
+
+DocumentFilter DocumentFilter::AnyOf(std::vector<DocumentFilter> filters) {
+    DocumentFilter filter(Kind::ANY_OF);
+    filter.children_ = std::move(filters);
+    return filter;
+}
+
+DocumentFilter::Kind DocumentFilter::GetKind() const {
+    return kind_;
+}
+
+const std::set<DocumentStatus>& DocumentFilter::GetStatuses() const {
+    return statuses_;
+}
+
+int DocumentFilter::GetMin() const {
+    return min_;
+}
+
+int DocumentFilter::GetMax() const {
+    return max_;
+}
+
+const std::vector<int>& DocumentFilter::GetDocumentIds() const {
+    return document_ids_;
+}
+
+const std::vector<DocumentFilter>& DocumentFilter::GetChildren() const {
+    return children_;
+}
+
+std::string DocumentFilter::ToString() const {
+    const auto join_ids = [](const std::vector<int>& values) {
+        std::string result;
+        for (const int value : values) {
+            if (!result.empty()) {
+                result += ',';
+            }
+            result += std::to_string(value);
+        }
+        return result;
+    };
+    switch (kind_) {
+        case Kind::ANY_DOCUMENT:
+            return "*"s;
+        case Kind::STATUS: {
+            std::vector<int> statuses;
+            for (const DocumentStatus status : statuses_) {
+                statuses.push_back(static_cast<int>(status));
+            }
+            return "status("s + join_ids(statuses) + ")"s;
+        }
+        case Kind::RATING_RANGE:
+            return "rating["s + std::to_string(min_) + ","s + std::to_string(max_) + "]"s;
+        case Kind::ID_RANGE:
+            return "id["s + std::to_string(min_) + ","s + std::to_string(max_) + "]"s;
+        case Kind::ID_IN:
+            return "in("s + join_ids(document_ids_) + ")"s;
+        case Kind::ID_NOT_IN:
+            return "not_in("s + join_ids(document_ids_) + ")"s;
+        case Kind::ALL_OF:
+        case Kind::ANY_OF: {
+            std::string result = kind_ == Kind::ALL_OF ? "all("s : "any("s;
+            for (size_t i = 0; i < children_.size(); ++i) {
+                result += (i == 0 ? ""s : ";"s) + children_[i].ToString();
+            }
+            return result + ")"s;
+        }
+    }
+    return {};
+}
+
+CompiledDocumentFilter::CompiledDocumentFilter(const DocumentFilter& filter, const FilterIndexes& indexes)
+        : root_(Compile(filter, indexes)) {
+}
+
+bool CompiledDocumentFilter::RejectsAll() const {
+    return root_.check == Check::REJECT_ALL;
+}
+
+CompiledDocumentFilter::Node CompiledDocumentFilter::Compile(const DocumentFilter& filter,
+                                                             const FilterIndexes& indexes) {
+    using Kind = DocumentFilter::Kind;
+    Node node;
+    switch (filter.GetKind()) {
+        case Kind::ANY_DOCUMENT:
+            node.check = Check::ACCEPT_ALL;
+            return node;
+        case Kind::STATUS: {
+            //на каждый статус своя битовая карта сервера, копировать их не нужно
+            std::vector<Node> children;
+            for (const DocumentStatus status : filter.GetStatuses()) {
+                const auto it = indexes.status_to_documents.find(status);
+                if (it != indexes.status_to_documents.end()) {
+                    children.push_back(MakeBorrowedBitmapNode(it->second));
+                }
+            }
+            return Combine(Check::ANY_OF, std::move(children));
+        }
+        case Kind::RATING_RANGE:
+            return CompileRatingRange(filter.GetMin(), filter.GetMax(), indexes);
+        case Kind::ID_RANGE:
+            if (filter.GetMin() > filter.GetMax()) {
+                node.check = Check::REJECT_ALL;
+                return node;
+            }
+            node.check = Check::ID_RANGE;
+            node.min = filter.GetMin();
+            node.max = filter.GetMax();
+            return node;
+        case Kind::ID_IN:
+        case Kind::ID_NOT_IN: {
+            auto bitmap = std::make_shared<DocumentBitmap>();
+            for (const int document_id : filter.GetDocumentIds()) {
+                if (document_id >= 0) {
+                    bitmap->Add(document_id);
+                }
+            }
+            return MakeBitmapNode(filter.GetKind() == Kind::ID_IN ? Check::IN_BITMAP : Check::NOT_IN_BITMAP,
+                                  std::move(bitmap));
+        }
+        case Kind::ALL_OF:
+        case Kind::ANY_OF: {
+            std::vector<Node> children;
+            for (const DocumentFilter& child : filter.GetChildren()) {
+                children.push_back(Compile(child, indexes));
+            }
+            return Combine(filter.GetKind() == Kind::ALL_OF ? Check::ALL_OF : Check::ANY_OF, std::move(children));
+        }
+    }
+    return node;
+}
+
+CompiledDocumentFilter::Node CompiledDocumentFilter::CompileRatingRange(int min_rating, int max_rating,
+                                                                       const FilterIndexes& indexes) {
+    const std::map<int, DocumentBitmap>& rating_to_documents = indexes.rating_to_documents;
+    Node node;
+    if (min_rating > max_rating) {
+        node.check = Check::REJECT_ALL;
+        return node;
+    }
+    const auto first = rating_to_documents.lower_bound(min_rating);
+    const auto last = rating_to_documents.upper_bound(max_rating);
+    const auto bucket_count = static_cast<size_t>(std::distance(first, last));
+    //диапазон покрывает все рейтинги корпуса - проверять нечего
+    if (bucket_count == rating_to_documents.size()) {
+        node.check = Check::ACCEPT_ALL;
+        return node;
+    }
+    if (bucket_count <= MAX_RATING_BUCKETS_TO_CHECK) {
+        std::vector<Node> children;
+        for (auto it = first; it != last; ++it) {
+            children.push_back(MakeBorrowedBitmapNode(it->second));
+        }
+        return Combine(Check::ANY_OF, std::move(children));
+    }
+    //если вне диапазона осталось мало корзин, проверяем, что документ не попал ни в одну из них
+    if (rating_to_documents.size() - bucket_count <= MAX_RATING_BUCKETS_TO_CHECK) {
+        std::vector<Node> children;
+        const auto exclude_bucket = [&children](const DocumentBitmap& bitmap) {
+            Node child = MakeBorrowedBitmapNode(bitmap);
+            if (child.check == Check::IN_BITMAP) {
+                child.check = Check::NOT_IN_BITMAP;
+                children.push_back(std::move(child));
+            }
+        };
+        for (auto it = rating_to_documents.begin(); it != first; ++it) {
+            exclude_bucket(it->second);
+        }
+        for (auto it = last; it != rating_to_documents.end(); ++it) {
+            exclude_bucket(it->second);
+        }
+        return Combine(Check::ALL_OF, std::move(children));
+    }
+    const auto unite = [first, last] {
+        DocumentBitmap bitmap;
+        for (auto it = first; it != last; ++it) {
+            bitmap |= it->second;
+        }
+        return bitmap;
+    };
+    if (indexes.rating_range_cache == nullptr) {
+        return MakeBitmapNode(Check::IN_BITMAP, std::make_shared<const DocumentBitmap>(unite()));
+    }
+    //ключ - крайние корзины, а не границы фильтра: диапазоны с одними и теми же корзинами делят объединение
+    return MakeBitmapNode(Check::IN_BITMAP, indexes.rating_range_cache->Get(first->first, std::prev(last)->first,
+                                                                            indexes.generation, unite));
+}
+
+RatingRangeCache& RatingRangeCache::operator=(const RatingRangeCache& other) {
+    if (this != &other) {
+        std::lock_guard guard(mutex_);
+        ranges_.clear();
+        generation_ = 0;
+    }
+    return *this;
+}
+
+CompiledDocumentFilter::Node CompiledDocumentFilter::MakeBorrowedBitmapNode(const DocumentBitmap& bitmap) {
+    Node node;
+    if (bitmap.Empty()) {
+        node.check = Check::REJECT_ALL;
+        return node;
+    }
+    node.check = Check::IN_BITMAP;
+    node.bitmap = &bitmap;
+    node.cost = 1;
+    return node;
+}
+
+CompiledDocumentFilter::Node CompiledDocumentFilter::MakeBitmapNode(Check check,
+                                                                   std::shared_ptr<const DocumentBitmap> bitmap) {
+    Node node;
+    if (bitmap->Empty()) {
+        node.check = check == Check::IN_BITMAP ? Check::REJECT_ALL : Check::ACCEPT_ALL;
+        return node;
+    }
+    node.check = check;
+    node.bitmap = bitmap.get();
+    node.owned_bitmap = std::move(bitmap);
+    node.cost = 1;
+    return node;
+}
+
+bool CompiledDocumentFilter::Accept(int document_id) const {
+    return Accept(root_, document_id);
+}
+
+bool CompiledDocumentFilter::Accept(const Node& node, int document_id) {
+    switch (node.check) {
+        case Check::ACCEPT_ALL:
+            return true;
+        case Check::REJECT_ALL:
+            return false;
+        case Check::IN_BITMAP:
+            return node.bitmap->Contains(document_id);
+        case Check::NOT_IN_BITMAP:
+            return !node.bitmap->Contains(document_id);
+        case Check::ID_RANGE:
+            return node.min <= document_id && document_id <= node.max;
+        case Check::ALL_OF:
+            for (const Node& child : node.children) {
+                if (!Accept(child, document_id)) {
+                    return false;
+                }
+            }
+            return true;
+        case Check::ANY_OF:
+            for (const Node& child : node.children) {
+                if (Accept(child, document_id)) {
+                    return true;
+                }
+            }
+            return false;
+    }
+    return false;
+}
+
+CompiledDocumentFilter::Node CompiledDocumentFilter::Combine(Check check, std::vector<Node> children) {
+    //для ALL_OF нейтральна проверка ACCEPT_ALL, а REJECT_ALL решает все сразу; для ANY_OF наоборот
+    const Check neutral = check == Check::ALL_OF ? Check::ACCEPT_ALL : Check::REJECT_ALL;
+    const Check absorbing = check == Check::ALL_OF ? Check::REJECT_ALL : Check::ACCEPT_ALL;
+
+    Node node;
+    for (Node& child : children) {
+        if (child.check == absorbing) {
+            node.check = absorbing;
+            return node;
+        }
+        if (child.check != neutral) {
+            node.cost += child.cost;
+            node.children.push_back(std::move(child));
+        }
+    }
+    if (node.children.empty()) {
+        node.check = neutral;
+        return node;
+    }
+    if (node.children.size() == 1) {
+        return std::move(node.children.front());
+    }
+    std::stable_sort(node.children.begin(), node.children.end(), [](const Node& lhs, const Node& rhs) {
+        return lhs.cost < rhs.cost;
+    });
+    node.check = check;
+    return node;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <climits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "document_bitmap.h"
+
+/*
+ * Структурированный фильтр документов - альтернатива непрозрачному предикату (id, status, rating) -> bool.
+ * Из условий на статус, рейтинг и id, объединенных через AllOf/AnyOf, поисковый сервер
+ * заранее строит проверки по битовым картам и диапазонам, которые выполняются до начисления релевантности.
+ *
+ * Пример: документы со статусом ACTUAL и рейтингом не ниже 3, либо документы 10 и 20:
+ *  DocumentFilter::AnyOf({
+ *      DocumentFilter::AllOf({DocumentFilter::Status({DocumentStatus::ACTUAL}), DocumentFilter::RatingRange(3, INT_MAX)}),
+ *      DocumentFilter::IdIn({10, 20})
+ *  })
+ */
+class DocumentFilter {
+public:
+    enum class Kind {
+        ANY_DOCUMENT,
+        STATUS,
+        RATING_RANGE,
+        ID_RANGE,
+        ID_IN,
+        ID_NOT_IN,
+        ALL_OF,
+        ANY_OF,
+    };
+
+    // фильтр по умолчанию пропускает все документы
+    DocumentFilter() = default;
+
+    static DocumentFilter Status(std::set<DocumentStatus> statuses);
+    // границы диапазонов включаются
+    static DocumentFilter RatingRange(int min_rating, int max_rating);
+    static DocumentFilter IdRange(int min_id, int max_id);
+    static DocumentFilter IdIn(std::vector<int> document_ids);
+    static DocumentFilter IdNotIn(std::vector<int> document_ids);
+
+    static DocumentFilter AllOf(std::vector<DocumentFilter> filters);
+    static DocumentFilter AnyOf(std::vector<DocumentFilter> filters);
+
+    [[nodiscard]] Kind GetKind() const;
+    [[nodiscard]] const std::set<DocumentStatus>& GetStatuses() const;
+    [[nodiscard]] int GetMin() const;
+    [[nodiscard]] int GetMax() const;
+    [[nodiscard]] const std::vector<int>& GetDocumentIds() const;
+    [[nodiscard]] const std::vector<DocumentFilter>& GetChildren() const;
+
+    // каноническая запись фильтра, годится как часть ключа кеша
+    [[nodiscard]] std::string ToString() const;
+
+private:
+    Kind kind_ = Kind::ANY_DOCUMENT;
+    std::set<DocumentStatus> statuses_;
+    int min_ = INT_MIN;
+    int max_ = INT_MAX;
+    std::vector<int> document_ids_;
+    std::vector<DocumentFilter> children_;
+
+    explicit DocumentFilter(Kind kind);
+};
+
+/*
+ * Объединения корзин рейтинга для широких диапазонов: объединение строится при первой компиляции
+ * диапазона и переиспользуется, пока не изменится поколение индекса. Хранится не больше MAX_RANGES
+ * объединений, при переполнении кеш очищается. Копия начинает с пустого кеша.
+ */
+class RatingRangeCache {
+public:
+    RatingRangeCache() = default;
+    RatingRangeCache(const RatingRangeCache&) {}
+    RatingRangeCache& operator=(const RatingRangeCache& other);
+
+    // объединение корзин с рейтингами от first_rating до last_rating включительно; build() строит его при промахе
+    template <typename Builder>
+    std::shared_ptr<const DocumentBitmap> Get(int first_rating, int last_rating, uint64_t generation,
+                                              Builder build) const;
+
+private:
+    static constexpr size_t MAX_RANGES = 64;
+
+    mutable std::mutex mutex_;
+    mutable std::map<std::pair<int, int>, std::shared_ptr<const DocumentBitmap>> ranges_;
+    mutable uint64_t generation_ = 0;
+};
+
+template <typename Builder>
+std::shared_ptr<const DocumentBitmap> RatingRangeCache::Get(int first_rating, int last_rating, uint64_t generation,
+                                                            Builder build) const {
+    std::lock_guard guard(mutex_);
+    if (generation_ != generation || ranges_.size() >= MAX_RANGES) {
+        ranges_.clear();
+        generation_ = generation;
+    }
+    auto& bitmap = ranges_[{first_rating, last_rating}];
+    if (!bitmap) {
+        bitmap = std::make_shared<const DocumentBitmap>(build());
+    }
+    return bitmap;
+}
+
+// индексы поискового сервера, по которым компилируется фильтр
+struct FilterIndexes {
+    const std::map<DocumentStatus, DocumentBitmap>& status_to_documents;
+    // документы, сгруппированные по рейтингу, по возрастанию рейтинга
+    const std::map<int, DocumentBitmap>& rating_to_documents;
+    // объединения корзин для широких диапазонов рейтинга; без кеша они строятся при каждой компиляции
+    const RatingRangeCache* rating_range_cache = nullptr;
+    uint64_t generation = 0;
+};
+
+/*
+ * Фильтр, скомпилированный под индексы конкретного поискового сервера: условия на статус, рейтинг и списки id
+ * превращены в проверки по битовым картам, константные ветви свернуты (в том числе диапазон рейтинга,
+ * в который не попал ни один документ), а в AllOf/AnyOf дешевые проверки идут раньше дорогих.
+ */
+class CompiledDocumentFilter {
+public:
+    CompiledDocumentFilter(const DocumentFilter& filter, const FilterIndexes& indexes);
+
+    // true, если фильтр не пропустит ни одного документа
+    [[nodiscard]] bool RejectsAll() const;
+
+    [[nodiscard]] bool Accept(int document_id) const;
+
+private:
+    enum class Check {
+        ACCEPT_ALL,
+        REJECT_ALL,
+        IN_BITMAP,
+        NOT_IN_BITMAP,
+        ID_RANGE,
+        ALL_OF,
+        ANY_OF,
+    };
+
+    //диапазон рейтинга из стольких корзин проверяем по каждой корзине, а из большего числа - объединяем
+    static constexpr size_t MAX_RATING_BUCKETS_TO_CHECK = 4;
+
+    struct Node {
+        Check check = Check::ACCEPT_ALL;
+        const DocumentBitmap* bitmap = nullptr;
+        std::shared_ptr<const DocumentBitmap> owned_bitmap;
+        int min = INT_MIN;
+        int max = INT_MAX;
+        std::vector<Node> children;
+        int cost = 0;
+    };
+
+    Node root_;
+
+    static Node Compile(const DocumentFilter& filter, const FilterIndexes& indexes);
+    static Node CompileRatingRange(int min_rating, int max_rating, const FilterIndexes& indexes);
+    static Node MakeBitmapNode(Check check, std::shared_ptr<const DocumentBitmap> bitmap);
+    static Node MakeBorrowedBitmapNode(const DocumentBitmap& bitmap);
+    static Node Combine(Check check, std::vector<Node> children);
+
+    static bool Accept(const Node& node, int document_id);
+};
@@ -0,0 +1,160 @@
+#include "impact_index.h"
+
+#include <cmath>
+
+ImpactIndex::ImpactIndex(const std::map<std::string_view, std::map<int, double>>& word_to_document_freqs,
+                         int document_count) {
+    const auto inverse_document_freq = [document_count](const std::map<int, double>& document_freqs) {
+        return std::log(document_count * 1.0 / document_freqs.size());
+    };
+    //вес одного кванта выбираем по самому большому вкладу во всем индексе
+    double max_impact = 0.0;
+    for (const auto& [word, document_freqs] : word_to_document_freqs) {
+        if (document_freqs.empty()) {
+            continue;
+        }
+        const double idf = inverse_document_freq(document_freqs);
+        for (const auto& [document_id, term_freq] : document_freqs) {
+            max_impact = std::max(max_impact, term_freq * idf);
+        }
+    }
+    const double quantum = max_impact > 0.0 ? max_impact / 255.0 : 1.0;
+
+    for (const auto& [word, document_freqs] : word_to_document_freqs) {
+        if (document_freqs.empty()) {
+            continue;
+        }
+        const double idf = inverse_document_freq(document_freqs);
+        std::vector<std::pair<Impact, int>> impacts;
+        impacts.reserve(document_freqs.size());
+        for (const auto& [document_id, term_freq] : document_freqs) {
+            //округляем вверх, чтобы ненулевой вклад не пропал при квантовании
+            const auto impact = static_cast<Impact>(std::min(255.0, std::ceil(term_freq * idf / quantum)));
+            impacts.emplace_back(impact, document_id);
+        }
+        std::sort(impacts.begin(), impacts.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+        });
+
+        Postings& postings = postings_[word];
+        postings.document_ids.reserve(impacts.size());
+        for (const auto& [impact, document_id] : impacts) {
+            if (postings.segments.empty() || postings.segments.back().impact != impact) {
+                postings.segments.push_back({impact, postings.document_ids.size(), postings.document_ids.size()});
+            }
+            postings.document_ids.push_back(document_id);
+            ++postings.segments.back().end;
+        }
+    }
+}
+
+const ImpactIndex::Postings* ImpactIndex::Find(std::string_view word) const {
+    const auto it = postings_.find(word);
+    return it == postings_.end() ? nullptr : &it->second;
+}
+
+ImpactIndex::TopScores::TopScores(const std::unordered_map<int, Score>& scores, size_t limit)
+        : scores_(scores)
+        , limit_(limit) {
+    top_.reserve(limit);
+}
+
+void ImpactIndex::TopScores::Update(int document_id, Score score) {
+    if (limit_ == 0) {
+        return;
+    }
+    if (const auto it = top_positions_.find(document_id); it != top_positions_.end()) {
+        //оценка выросла: в min-куче элемент может только опуститься
+        top_[it->second].first = score;
+        SiftDown(it->second);
+        return;
+    }
+    if (top_.size() < limit_) {
+        top_.emplace_back(score, document_id);
+        top_positions_[document_id] = top_.size() - 1;
+        SiftUp(top_.size() - 1);
+        return;
+    }
+    if (score > top_.front().first) {
+        //худший документ top-k уступает место и переходит к остальным
+        PushOutside(top_.front());
+        top_positions_.erase(top_.front().second);
+        Place(0, {score, document_id});
+        SiftDown(0);
+    } else {
+        PushOutside({score, document_id});
+    }
+}
+
+ImpactIndex::Score ImpactIndex::TopScores::GetKthScore() const {
+    return (limit_ == 0 || top_.size() < limit_) ? 0 : top_.front().first;
+}
+
+bool ImpactIndex::TopScores::IsFixed(Score remaining) {
+    //пока документов меньше limit, в top-k может попасть любой еще не встреченный документ
+    if (limit_ == 0 || top_.size() < limit_) {
+        return false;
+    }
+    //запись устарела, если документ с тех пор вошел в top-k или его оценка выросла
+    while (!outside_.empty()) {
+        const auto [score, document_id] = outside_.front();
+        if (top_positions_.count(document_id) == 0 && scores_.at(document_id) == score) {
+            break;
+        }
+        std::pop_heap(outside_.begin(), outside_.end());
+        outside_.pop_back();
+    }
+    const Score outside = outside_.empty() ? 0 : outside_.front().first;
+    return top_.front().first > outside + remaining;
+}
+
+void ImpactIndex::TopScores::SiftUp(size_t position) {
+    const Entry entry = top_[position];
+    while (position > 0) {
+        const size_t parent = (position - 1) / 2;
+        if (top_[parent].first <= entry.first) {
+            break;
+        }
+        Place(position, top_[parent]);
+        position = parent;
+    }
+    Place(position, entry);
+}
+
+void ImpactIndex::TopScores::SiftDown(size_t position) {
+    const Entry entry = top_[position];
+    while (true) {
+        size_t child = 2 * position + 1;
+        if (child >= top_.size()) {
+            break;
+        }
+        if (child + 1 < top_.size() && top_[child + 1].first < top_[child].first) {
+            ++child;
+        }
+        if (entry.first <= top_[child].first) {
+            break;
+        }
+        Place(position, top_[child]);
+        position = child;
+    }
+    Place(position, entry);
+}
+
+void ImpactIndex::TopScores::Place(size_t position, const Entry& entry) {
+    top_[position] = entry;
+    top_positions_[entry.second] = position;
+}
+
+void ImpactIndex::TopScores::PushOutside(const Entry& entry) {
+    outside_.push_back(entry);
+    std::push_heap(outside_.begin(), outside_.end());
+}
+
+LazyImpactIndex& LazyImpactIndex::operator=(const LazyImpactIndex& other) {
+    if (this != &other) {
+        std::lock_guard guard(mutex_);
+        index_.reset();
+        generation_ = 0;
+    }
+    return *this;
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Индекс, в котором постинги каждого слова упорядочены не по id документа, а по убыванию
+ * вклада слова в релевантность (tf*idf, квантованный в 0..255). Постинги с одинаковым вкладом
+ * образуют сегмент. Запрос обходится "score-at-a-time": сначала самые весомые сегменты всех
+ * слов запроса, и обход прекращается, как только top-k уже не может измениться,
+ * либо приближенно - после просмотра заданного числа постингов.
+ */
+class ImpactIndex {
+public:
+    using Impact = uint8_t;
+    // квантованная релевантность документа, накопленная по всем словам запроса
+    using Score = int;
+
+    struct Segment {
+        Impact impact;
+        size_t begin;
+        size_t end;
+    };
+
+    struct Postings {
+        std::vector<int> document_ids;  // сгруппированы по сегментам, сегменты по убыванию вклада
+        std::vector<Segment> segments;
+    };
+
+    ImpactIndex(const std::map<std::string_view, std::map<int, double>>& word_to_document_freqs, int document_count);
+
+    [[nodiscard]] const Postings* Find(std::string_view word) const;
+
+    /*
+     * Возвращает кандидатов в top-k по словам words: limit документов с наибольшей квантованной релевантностью
+     * и документы, отстающие от них не больше чем на погрешность квантования. Точный порядок
+     * кандидатов определяет вызывающий. accept(document_id) вызывается один раз для каждого встреченного документа и отсекает
+     * неподходящие документы (минус-слова, предикат). postings_budget == 0 - без ограничения.
+     * should_stop() вызывается на каждом постинге; если он вернул true, обход прекращается, как при исчерпании бюджета.
+     */
+    template <typename Words, typename DocumentAcceptor, typename StopCondition>
+    std::vector<std::pair<int, Score>> FindTop(const Words& words, size_t limit, size_t postings_budget,
+                                               DocumentAcceptor accept, StopCondition should_stop) const;
+
+private:
+    std::unordered_map<std::string_view, Postings> postings_;
+
+    /*
+     * Лучшие limit оценок, обновляемые при каждом изменении оценки документа: min-куча top-k
+     * с позициями документов в ней и ленивая max-куча остальных документов, устаревшие записи
+     * которой отбрасываются при чтении. Проверка остановки не перебирает все оценки.
+     */
+    class TopScores {
+    public:
+        // scores - текущие оценки документов, по ним отбрасываются устаревшие записи
+        TopScores(const std::unordered_map<int, Score>& scores, size_t limit);
+
+        // новая оценка документа; оценки документов только растут
+        void Update(int document_id, Score score);
+        // оценка limit-го по величине документа, либо 0, если документов меньше
+        [[nodiscard]] Score GetKthScore() const;
+        // true, если ни один документ вне top-k не догонит его, даже получив весь оставшийся вклад remaining
+        [[nodiscard]] bool IsFixed(Score remaining);
+
+    private:
+        using Entry = std::pair<Score, int>;
+
+        const std::unordered_map<int, Score>& scores_;
+        size_t limit_;
+        std::vector<Entry> top_;  // min-куча по оценке
+        std::unordered_map<int, size_t> top_positions_;
+        std::vector<Entry> outside_;  // max-куча по оценке, с устаревшими записями
+
+        void SiftUp(size_t position);
+        void SiftDown(size_t position);
+        void Place(size_t position, const Entry& entry);
+        void PushOutside(const Entry& entry);
+    };
+};
+
+/*
+ * Ленивая обертка над ImpactIndex: индекс перестраивается при первом запросе
+ * после изменения корпуса (смены поколения индекса). Копия начинает с пустого индекса.
+ */
+class LazyImpactIndex {
+public:
+    LazyImpactIndex() = default;
+    LazyImpactIndex(const LazyImpactIndex&) {}
+    LazyImpactIndex& operator=(const LazyImpactIndex& other);
+
+    template <typename Builder>
+    std::shared_ptr<const ImpactIndex> Get(uint64_t generation, Builder build) const;
+
+private:
+    mutable std::mutex mutex_;
+    mutable std::shared_ptr<const ImpactIndex> index_;
+    mutable uint64_t generation_ = 0;
+};
+
+template <typename Words, typename DocumentAcceptor, typename StopCondition>
+std::vector<std::pair<int, ImpactIndex::Score>> ImpactIndex::FindTop(const Words& words,
+                                                                     size_t limit, size_t postings_budget,
+                                                                     DocumentAcceptor accept,
+                                                                     StopCondition should_stop) const {
+    struct Cursor {
+        const Postings* postings;
+        size_t segment;
+    };
+    std::vector<Cursor> cursors;
+    Score remaining = 0;
+    for (std::string_view word : words) {
+        const Postings* postings = Find(word);
+        if (postings != nullptr && !postings->segments.empty()) {
+            cursors.push_back({postings, 0});
+            remaining += postings->segments.front().impact;
+        }
+    }
+    //квантование ошибается не больше чем на единицу на каждое слово запроса
+    const auto error = static_cast<Score>(cursors.size());
+
+    //отрицательная оценка помечает отвергнутый документ
+    std::unordered_map<int, Score> scores;
+    TopScores top(scores, limit);
+    size_t scanned = 0;
+    bool budget_exhausted = false;
+    while (!cursors.empty() && !budget_exhausted) {
+        //следующий уровень вклада - максимальный среди непросмотренных сегментов
+        Impact level = 0;
+        for (const Cursor& cursor : cursors) {
+            level = std::max(level, cursor.postings->segments[cursor.segment].impact);
+        }
+        for (Cursor& cursor : cursors) {
+            const Segment& segment = cursor.postings->segments[cursor.segment];
+            if (segment.impact != level) {
+                continue;
+            }
+            for (size_t i = segment.begin; i < segment.end; ++i) {
+                const int document_id = cursor.postings->document_ids[i];
+                auto [it, inserted] = scores.emplace(document_id, 0);
+                if (inserted && !accept(document_id)) {
+                    it->second = -1;
+                }
+                if (it->second >= 0) {
+                    it->second += segment.impact;
+                    top.Update(document_id, it->second);
+                }
+                if (should_stop() || (postings_budget != 0 && ++scanned >= postings_budget)) {
+                    budget_exhausted = true;
+                    break;
+                }
+            }
+            remaining -= segment.impact;
+            ++cursor.segment;
+            if (cursor.segment < cursor.postings->segments.size()) {
+                remaining += cursor.postings->segments[cursor.segment].impact;
+            }
+            if (budget_exhausted) {
+                break;
+            }
+        }
+        cursors.erase(std::remove_if(cursors.begin(), cursors.end(), [](const Cursor& cursor) {
+            return cursor.segment == cursor.postings->segments.size();
+        }), cursors.end());
+        if (top.IsFixed(remaining + error)) {
+            break;
+        }
+    }
+
+    const Score threshold = top.GetKthScore() - error;
+    std::vector<std::pair<int, Score>> result;
+    for (const auto& [document_id, score] : scores) {
+        if (score >= 0 && score >= threshold) {
+            result.emplace_back(document_id, score);
+        }
+    }
+    return result;
+}
+
+template <typename Builder>
+std::shared_ptr<const ImpactIndex> LazyImpactIndex::Get(uint64_t generation, Builder build) const {
+    std::lock_guard guard(mutex_);
+    if (!index_ || generation_ != generation) {
+        index_ = std::make_shared<const ImpactIndex>(build());
+        generation_ = generation;
+    }
+    return index_;
+}
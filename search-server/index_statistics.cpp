@@ -0,0 +1,51 @@
+#include "index_statistics.h"
+
+using namespace std::literals;
+
+namespace {
+
+std::string_view GetStatusName(size_t status) {
+    switch (static_cast<DocumentStatus>(status)) {
+        case DocumentStatus::ACTUAL:
+            return "ACTUAL"sv;
+        case DocumentStatus::IRRELEVANT:
+            return "IRRELEVANT"sv;
+        case DocumentStatus::BANNED:
+            return "BANNED"sv;
+        case DocumentStatus::REMOVED:
+            return "REMOVED"sv;
+    }
+    return "unknown"sv;
+}
+
+}  // namespace
+
+std::ostream& operator<<(std::ostream& out, const IndexStatistics& statistics) {
+    out << "documents = "sv << statistics.document_count << ", vocabulary = "sv << statistics.vocabulary_size
+        << ", postings = "sv << statistics.total_postings
+        << ", unique terms per document = "sv << statistics.average_unique_terms_per_document
+        << ", memory = "sv << statistics.index_memory_bytes << " bytes"sv << std::endl;
+    out << "documents by status:"sv;
+    for (size_t status = 0; status < IndexStatistics::STATUS_COUNT; ++status) {
+        out << ' ' << GetStatusName(status) << " = "sv << statistics.status_document_counts[status];
+    }
+    out << std::endl;
+    const IndexStatistics::PostingLengths& lengths = statistics.posting_lengths;
+    out << "posting lengths: min = "sv << lengths.min << ", p50 = "sv << lengths.p50 << ", p90 = "sv << lengths.p90
+        << ", p99 = "sv << lengths.p99 << ", max = "sv << lengths.max << ", mean = "sv << lengths.mean << std::endl;
+    out << "posting length histogram:"sv << std::endl;
+    for (size_t bucket = 0; bucket < statistics.posting_length_histogram.size(); ++bucket) {
+        out << "  ["sv << (size_t{1} << bucket) << ", "sv << (size_t{1} << (bucket + 1)) << "): "sv
+            << statistics.posting_length_histogram[bucket] << std::endl;
+    }
+    out << "longest postings:"sv << std::endl;
+    for (const auto& [word, length] : statistics.longest_postings) {
+        out << "  "sv << word << ": "sv << length << std::endl;
+    }
+    out << "stop words: hits = "sv << statistics.stop_word_hits << " of "sv << statistics.ingested_words
+        << " words, rate = "sv << statistics.stop_word_hit_rate << std::endl;
+    for (const auto& [word, hits] : statistics.stop_word_counts) {
+        out << "  "sv << word << ": "sv << hits << std::endl;
+    }
+    return out;
+}
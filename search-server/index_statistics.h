@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+
+/*
+ * Сводка по индексу сервера (SearchServer::GetIndexStatistics): словарь, распределение длин
+ * списков документов слов (постингов), самые длинные постинги, документы по статусам
+ * и доля стоп-слов среди слов добавленных документов
+ */
+struct IndexStatistics {
+    struct PostingLengths {
+        size_t min = 0;
+        size_t p50 = 0;
+        size_t p90 = 0;
+        size_t p99 = 0;
+        size_t max = 0;
+        double mean = 0.0;
+    };
+
+    static constexpr size_t STATUS_COUNT = 4;
+
+    size_t document_count = 0;
+    size_t vocabulary_size = 0;  // слов, встречающихся хотя бы в одном документе
+    size_t total_postings = 0;   // пар (слово, документ)
+    double average_unique_terms_per_document = 0.0;
+    size_t index_memory_bytes = 0;  // SearchServer::GetIndexMemoryUsage
+    PostingLengths posting_lengths;
+    // posting_length_histogram[i] - число слов с длиной постинга в [2^i, 2^(i+1))
+    std::vector<size_t> posting_length_histogram;
+    // самые длинные постинги по убыванию длины, при равенстве по слову
+    std::vector<std::pair<std::string, size_t>> longest_postings;
+    // документы по статусам, индекс - static_cast<size_t>(DocumentStatus)
+    std::array<size_t, STATUS_COUNT> status_document_counts = {};
+    // счетчики копятся с создания сервера и не уменьшаются при удалении документов
+    uint64_t ingested_words = 0;  // слов в текстах добавленных документов, включая стоп-слова
+    uint64_t stop_word_hits = 0;
+    double stop_word_hit_rate = 0.0;  // stop_word_hits / ingested_words
+    // попадания по стоп-словам, по убыванию числа попаданий
+    std::vector<std::pair<std::string, uint64_t>> stop_word_counts;
+};
+
+std::ostream& operator<<(std::ostream& out, const IndexStatistics& statistics);
@@ -0,0 +1,15 @@
+#pragma once
+
+// склеивает аргументы после их раскрытия: PROFILE_CONCAT(name, __LINE__) дает имя с номером строки
+#define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
+#define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
+
+/*
+ * Общий на программу объект, который не разрушается: потоки могут завершаться
+ * и обращаться к нему после выхода из main
+ */
+template <typename T>
+T& GetLeakedInstance() {
+    static auto* instance = new T;
+    return *instance;
+}
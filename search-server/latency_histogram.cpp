@@ -0,0 +1,121 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// номер старшего единичного бита, value > 0
+size_t HighestBit(uint64_t value) {
+#if defined(__GNUC__)
+    return 63 - static_cast<size_t>(__builtin_clzll(value));
+#else
+    size_t bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+}  // namespace
+
+LatencyHistogram::LatencyHistogram(const LatencyHistogram& other) {
+    Merge(other);
+}
+
+LatencyHistogram& LatencyHistogram::operator=(const LatencyHistogram& other) {
+    if (this != &other) {
+        Reset();
+        Merge(other);
+    }
+    return *this;
+}
+
+void LatencyHistogram::Record(uint64_t nanoseconds) {
+    buckets_[GetBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    total_.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds duration) {
+    Record(static_cast<uint64_t>(std::max<std::chrono::nanoseconds::rep>(duration.count(), 0)));
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        const uint64_t count = other.buckets_[bucket].load(std::memory_order_relaxed);
+        if (count != 0) {
+            buckets_[bucket].fetch_add(count, std::memory_order_relaxed);
+        }
+    }
+    total_.fetch_add(other.total_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    total_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+    uint64_t count = 0;
+    for (const auto& bucket : buckets_) {
+        count += bucket.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+uint64_t LatencyHistogram::GetTotal() const {
+    return total_.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetPercentile(double quantile) const {
+    const uint64_t count = GetCount();
+    if (count == 0) {
+        return 0;
+    }
+    //ранг искомого значения, от 1 до count
+    const auto rank = std::clamp<uint64_t>(static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(count))),
+                                           1, count);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        seen += buckets_[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return GetBucketUpperBound(bucket);
+        }
+    }
+    return MAX_VALUE;
+}
+
+uint64_t LatencyHistogram::GetBucketCount(size_t bucket) const {
+    return buckets_.at(bucket).load(std::memory_order_relaxed);
+}
+
+size_t LatencyHistogram::GetBucket(uint64_t nanoseconds) {
+    const uint64_t value = std::min(nanoseconds, MAX_VALUE);
+    if (value < SUB_BUCKETS) {
+        return static_cast<size_t>(value);
+    }
+    //старший бит задает степень двойки, следующие SUB_BUCKET_BITS битов - корзину внутри нее
+    const size_t exponent = HighestBit(value);
+    const auto sub_bucket = static_cast<size_t>(value >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t LatencyHistogram::GetBucketLowerBound(size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    const size_t exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    const uint64_t sub_bucket = bucket % SUB_BUCKETS;
+    return (SUB_BUCKETS + sub_bucket) << (exponent - SUB_BUCKET_BITS);
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    const size_t exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    return GetBucketLowerBound(bucket) + (uint64_t{1} << (exponent - SUB_BUCKET_BITS)) - 1;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Гистограмма длительностей в наносекундах в духе HDR Histogram: каждая степень двойки делится
+ * на SUB_BUCKETS равных корзин, поэтому относительная погрешность не больше 1/SUB_BUCKETS
+ * при фиксированном размере. Значения больше MAX_VALUE попадают в последнюю корзину.
+ * Record можно вызывать из нескольких потоков без блокировок; чтение во время записи дает
+ * согласованный с точностью до одновременно записываемых значений результат.
+ */
+class LatencyHistogram {
+public:
+    static constexpr size_t SUB_BUCKET_BITS = 3;
+    static constexpr size_t SUB_BUCKETS = size_t{1} << SUB_BUCKET_BITS;
+    // старший учитываемый разряд: 2^36 нс - больше минуты
+    static constexpr size_t MAX_EXPONENT = 35;
+    static constexpr size_t BUCKET_COUNT = SUB_BUCKETS + (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+    static constexpr uint64_t MAX_VALUE = (uint64_t{1} << (MAX_EXPONENT + 1)) - 1;
+
+    LatencyHistogram() = default;
+    LatencyHistogram(const LatencyHistogram& other);
+    LatencyHistogram& operator=(const LatencyHistogram& other);
+
+    void Record(uint64_t nanoseconds);
+    void Record(std::chrono::nanoseconds duration);
+    void Merge(const LatencyHistogram& other);
+    void Reset();
+
+    [[nodiscard]] uint64_t GetCount() const;
+    [[nodiscard]] uint64_t GetTotal() const;
+    // верхняя граница корзины, в которую попадает доля quantile (от 0 до 1) значений; 0 для пустой гистограммы
+    [[nodiscard]] uint64_t GetPercentile(double quantile) const;
+    [[nodiscard]] uint64_t GetBucketCount(size_t bucket) const;
+
+    [[nodiscard]] static size_t GetBucket(uint64_t nanoseconds);
+    [[nodiscard]] static uint64_t GetBucketLowerBound(size_t bucket);
+    [[nodiscard]] static uint64_t GetBucketUpperBound(size_t bucket);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_ = {};
+    std::atomic<uint64_t> total_ = 0;
+};
@@ -4,8 +4,9 @@
 #include <iostream>
 #include <string_view>
 
-#define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
-#define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
+#include "instrumentation.h"
+#include "trace.h"
+
 #define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
 
 /**
@@ -29,6 +30,8 @@
  *      Task1();
  *      Task2();
  *  }
+ *
+ * Пока идет запись трассы (Trace::Start), замер попадает и в нее.
  */
 #define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
 
@@ -62,6 +65,11 @@ public:
         using namespace std::literals;
 
         const auto end_time = Clock::now();
+#if SEARCH_SERVER_TRACING
+        if (Trace::IsEnabled()) {
+            Trace::AddEvent(Trace::InternName(id_), start_time_, end_time);
+        }
+#endif
         const auto dur = end_time - start_time_;
         dst_stream_ << id_ << ": "sv << duration_cast<milliseconds>(dur).count() << " ms"sv << std::endl;
     }
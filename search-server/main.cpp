@@ -12,7 +12,13 @@
 #include "../Google_tests/test_par_2_3.h"
 #include "../Google_tests/TestSprint8_par.h"
 
-int main() {
+int main(int argc, char* argv[]) {
+    //сводка по индексу: ./cpp-search-server --index-stats "стоп слова" < documents.txt
+    if (argc > 1 && argv[1] == "--index-stats"sv) {
+        PrintIndexStatistics(std::cin, argc > 2 ? argv[2] : ""sv);
+        return 0;
+    }
+
     TestSearchServer();
     // Если вы видите эту строку, значит все тесты прошли успешно
     std::cout << "Search server testing finished"s << std::endl;
@@ -0,0 +1,259 @@
+#include "metrics_registry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std::literals;
+
+namespace {
+
+bool IsValidName(std::string_view name, bool allow_colon) {
+    const auto is_name_char = [allow_colon](char c, bool first) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (allow_colon && c == ':')
+               || (!first && c >= '0' && c <= '9');
+    };
+    if (name.empty() || !is_name_char(name.front(), true)) {
+        return false;
+    }
+    return std::all_of(name.begin() + 1, name.end(), [&is_name_char](char c) {
+        return is_name_char(c, false);
+    });
+}
+
+void WriteEscaped(std::ostream& output, std::string_view text, bool escape_quote) {
+    for (const char c : text) {
+        if (c == '\\') {
+            output << "\\\\"sv;
+        } else if (c == '\n') {
+            output << "\\n"sv;
+        } else if (escape_quote && c == '"') {
+            output << "\\\""sv;
+        } else {
+            output << c;
+        }
+    }
+}
+
+void WriteValue(std::ostream& output, double value) {
+    if (std::isnan(value)) {
+        output << "NaN"sv;
+    } else if (std::isinf(value)) {
+        output << (value > 0 ? "+Inf"sv : "-Inf"sv);
+    } else if (value == std::trunc(value) && std::abs(value) < 9'007'199'254'740'992.0) {
+        //целые, в том числе счетчики, без экспоненты и дробной части
+        output << static_cast<int64_t>(value);
+    } else {
+        const auto precision = output.precision(std::numeric_limits<double>::digits10);
+        output << value;
+        output.precision(precision);
+    }
+}
+
+//extra_label - метка le корзины гистограммы, добавляется последней
+void WriteLabels(std::ostream& output, const MetricsRegistry::Labels& labels,
+                 const std::pair<std::string_view, std::string_view>* extra_label = nullptr) {
+    if (labels.empty() && extra_label == nullptr) {
+        return;
+    }
+    output << '{';
+    bool is_first = true;
+    const auto write_label = [&output, &is_first](std::string_view name, std::string_view value) {
+        if (!is_first) {
+            output << ',';
+        }
+        is_first = false;
+        output << name << "=\""sv;
+        WriteEscaped(output, value, true);
+        output << '"';
+    };
+    for (const auto& [name, value] : labels) {
+        write_label(name, value);
+    }
+    if (extra_label != nullptr) {
+        write_label(extra_label->first, extra_label->second);
+    }
+    output << '}';
+}
+
+}  // namespace
+
+MetricsRegistry::Counter& MetricsRegistry::AddCounter(const std::string& name, const std::string& help, Labels labels) {
+    auto counter = std::make_unique<Counter>();
+    Counter& result = *counter;
+    std::lock_guard guard(mutex_);
+    AddSeries(name, help, MetricType::COUNTER, std::move(labels)).counter = std::move(counter);
+    return result;
+}
+
+void MetricsRegistry::AddCounter(const std::string& name, const std::string& help, ValueFunction value, Labels labels) {
+    std::lock_guard guard(mutex_);
+    AddSeries(name, help, MetricType::COUNTER, std::move(labels)).value = std::move(value);
+}
+
+void MetricsRegistry::AddGauge(const std::string& name, const std::string& help, ValueFunction value, Labels labels) {
+    std::lock_guard guard(mutex_);
+    AddSeries(name, help, MetricType::GAUGE, std::move(labels)).value = std::move(value);
+}
+
+void MetricsRegistry::AddHistogram(const std::string& name, const std::string& help, HistogramFunction histogram,
+                                   Labels labels) {
+    std::lock_guard guard(mutex_);
+    AddSeries(name, help, MetricType::HISTOGRAM, std::move(labels)).histogram = std::move(histogram);
+}
+
+void MetricsRegistry::AddHistograms(const std::string& name, const std::string& help, HistogramsFunction histograms,
+                                    std::vector<Labels> series_labels) {
+    const auto group = std::make_shared<const HistogramGroup>(HistogramGroup{std::move(histograms)});
+    std::lock_guard guard(mutex_);
+    for (size_t i = 0; i < series_labels.size(); ++i) {
+        Series& series = AddSeries(name, help, MetricType::HISTOGRAM, std::move(series_labels[i]));
+        series.group = group;
+        series.group_index = i;
+    }
+}
+
+void MetricsRegistry::RenderText(std::ostream& output) const {
+    std::lock_guard guard(mutex_);
+    for (const Family& family : families_) {
+        output << "# HELP "sv << family.name << ' ';
+        WriteEscaped(output, family.help, false);
+        output << "\n# TYPE "sv << family.name << ' ';
+        switch (family.type) {
+            case MetricType::COUNTER:
+                output << "counter\n"sv;
+                break;
+            case MetricType::GAUGE:
+                output << "gauge\n"sv;
+                break;
+            case MetricType::HISTOGRAM:
+                output << "histogram\n"sv;
+                break;
+        }
+        //функция группы вызывается один раз на вывод, ее гистограммы делят все ряды группы
+        std::unordered_map<const HistogramGroup*, std::vector<LatencyHistogram>> group_histograms;
+        for (const Series& series : family.series) {
+            if (family.type == MetricType::HISTOGRAM && series.group) {
+                auto [it, inserted] = group_histograms.try_emplace(series.group.get());
+                if (inserted) {
+                    it->second = series.group->histograms();
+                }
+                if (series.group_index >= it->second.size()) {
+                    throw std::logic_error("Функция гистограмм метрики "s + family.name
+                                           + " вернула меньше гистограмм, чем зарегистрировано рядов"s);
+                }
+                RenderHistogram(output, family, series, it->second[series.group_index]);
+                continue;
+            }
+            if (family.type == MetricType::HISTOGRAM) {
+                RenderHistogram(output, family, series, series.histogram());
+                continue;
+            }
+            output << family.name;
+            WriteLabels(output, series.labels);
+            output << ' ';
+            WriteValue(output, series.counter ? static_cast<double>(series.counter->Get()) : series.value());
+            output << '\n';
+        }
+    }
+}
+
+std::string MetricsRegistry::RenderText() const {
+    std::ostringstream output;
+    RenderText(output);
+    return output.str();
+}
+
+void MetricsRegistry::WriteTextFile(const std::string& path) const {
+    const std::string temporary_path = path + ".tmp"s;
+    {
+        std::ofstream output(temporary_path, std::ios::trunc);
+        RenderText(output);
+        output.close();
+        if (!output) {
+            throw std::runtime_error("Не удалось записать метрики в файл "s + temporary_path);
+        }
+    }
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        std::remove(temporary_path.c_str());
+        throw std::runtime_error("Не удалось переименовать файл метрик в "s + path);
+    }
+}
+
+//private:
+MetricsRegistry::Series& MetricsRegistry::AddSeries(const std::string& name, const std::string& help, MetricType type,
+                                                    Labels labels) {
+    if (!IsValidName(name, true)) {
+        throw std::invalid_argument("Недопустимое имя метрики "s + name);
+    }
+    for (const auto& [label_name, _] : labels) {
+        //метку le гистограмма добавляет сама
+        if (!IsValidName(label_name, false) || (type == MetricType::HISTOGRAM && label_name == "le"s)) {
+            throw std::invalid_argument("Недопустимое имя метки "s + label_name + " метрики "s + name);
+        }
+    }
+    auto family = std::find_if(families_.begin(), families_.end(), [&name](const Family& family) {
+        return family.name == name;
+    });
+    if (family == families_.end()) {
+        family = families_.insert(families_.end(), Family{name, help, type, {}});
+    } else if (family->type != type || family->help != help) {
+        throw std::invalid_argument("Метрика "s + name + " уже зарегистрирована с другим типом или описанием"s);
+    }
+    const bool is_duplicate = std::any_of(family->series.begin(), family->series.end(), [&labels](const Series& series) {
+        return series.labels == labels;
+    });
+    if (is_duplicate) {
+        throw std::invalid_argument("Ряд метрики "s + name + " с такими метками уже зарегистрирован"s);
+    }
+    family->series.push_back({std::move(labels), nullptr, nullptr, nullptr, nullptr, 0});
+    return family->series.back();
+}
+
+void MetricsRegistry::RenderHistogram(std::ostream& output, const Family& family, const Series& series,
+                                      const LatencyHistogram& histogram) {
+    //значение корзины LatencyHistogram относится к первой границе не меньше ее верхнего края,
+    //поэтому у границы счетчики могут быть немного занижены, но не завышены
+    std::array<uint64_t, HISTOGRAM_BOUNDS.size()> bound_counts = {};
+    uint64_t count = 0;
+    for (size_t bucket = 0; bucket < LatencyHistogram::BUCKET_COUNT; ++bucket) {
+        const uint64_t bucket_count = histogram.GetBucketCount(bucket);
+        if (bucket_count == 0) {
+            continue;
+        }
+        count += bucket_count;
+        const double upper_bound = static_cast<double>(LatencyHistogram::GetBucketUpperBound(bucket)) / 1e9;
+        const auto bound = std::lower_bound(HISTOGRAM_BOUNDS.begin(), HISTOGRAM_BOUNDS.end(), upper_bound);
+        if (bound != HISTOGRAM_BOUNDS.end()) {
+            bound_counts[static_cast<size_t>(bound - HISTOGRAM_BOUNDS.begin())] += bucket_count;
+        }
+    }
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= HISTOGRAM_BOUNDS.size(); ++i) {
+        std::string le = "+Inf"s;
+        if (i < HISTOGRAM_BOUNDS.size()) {
+            cumulative += bound_counts[i];
+            std::ostringstream bound_text;
+            WriteValue(bound_text, HISTOGRAM_BOUNDS[i]);
+            le = bound_text.str();
+        } else {
+            cumulative = count;
+        }
+        const std::pair<std::string_view, std::string_view> le_label = {"le"sv, le};
+        output << family.name << "_bucket"sv;
+        WriteLabels(output, series.labels, &le_label);
+        output << ' ' << cumulative << '\n';
+    }
+    output << family.name << "_sum"sv;
+    WriteLabels(output, series.labels);
+    output << ' ';
+    WriteValue(output, static_cast<double>(histogram.GetTotal()) / 1e9);
+    output << '\n' << family.name << "_count"sv;
+    WriteLabels(output, series.labels);
+    output << ' ' << count << '\n';
+}
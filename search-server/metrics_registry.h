@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "latency_histogram.h"
+
+/*
+ * Реестр метрик с выводом в текстовом формате Prometheus. Метрика - семейство с именем, описанием
+ * и типом, в семействе - ряды с разными метками. Значение ряда либо хранится в реестре
+ * (Counter: увеличивается без блокировок), либо снимается функцией при каждом выводе -
+ * так реестр читает статистику сервера, очереди запросов и кешей, не дублируя их счетчики.
+ * Регистрация и вывод берут блокировку реестра; функции вызываются под ней.
+ *
+ * Имя метрики - [a-zA-Z_:][a-zA-Z0-9_:]*, имя метки - [a-zA-Z_][a-zA-Z0-9_]*. Недопустимое имя,
+ * повтор ряда с теми же метками, другой тип или описание под уже зарегистрированным именем -
+ * std::invalid_argument.
+ */
+class MetricsRegistry {
+public:
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+    using ValueFunction = std::function<double()>;
+    // гистограмма длительностей в наносекундах, выводится в секундах
+    using HistogramFunction = std::function<LatencyHistogram()>;
+    // гистограммы нескольких рядов, снимаемые одним вызовом: по одной на каждый набор меток
+    using HistogramsFunction = std::function<std::vector<LatencyHistogram>()>;
+
+    class Counter {
+    public:
+        void Increment(uint64_t value = 1) {
+            value_.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] uint64_t Get() const {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> value_ = 0;
+    };
+
+    // границы корзин гистограмм в секундах, кроме +Inf
+    static constexpr std::array<double, 18> HISTOGRAM_BOUNDS = {
+            0.000001, 0.00001, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01,
+            0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0,
+    };
+
+    // счетчик, хранящийся в реестре; ссылка действительна, пока жив реестр
+    Counter& AddCounter(const std::string& name, const std::string& help, Labels labels = {});
+    // монотонный счетчик, значение которого снимается функцией
+    void AddCounter(const std::string& name, const std::string& help, ValueFunction value, Labels labels = {});
+    void AddGauge(const std::string& name, const std::string& help, ValueFunction value, Labels labels = {});
+    void AddHistogram(const std::string& name, const std::string& help, HistogramFunction histogram,
+                      Labels labels = {});
+    /* Ряды series_labels одной гистограммы, которые при выводе берут значения из одного вызова histograms:
+     * i-й ряд получает i-ю гистограмму. Так ряды согласованы между собой, а дорогой снимок
+     * снимается один раз на вывод. Если функция вернет меньше гистограмм, чем рядов, вывод
+     * выбросит std::logic_error
+     */
+    void AddHistograms(const std::string& name, const std::string& help, HistogramsFunction histograms,
+                       std::vector<Labels> series_labels);
+
+    void RenderText(std::ostream& output) const;
+    [[nodiscard]] std::string RenderText() const;
+    /* Пишет вывод во временный файл рядом с path и переименовывает его в path,
+     * так что читающий файл не увидит его недописанным. Ошибка записи - std::runtime_error
+     */
+    void WriteTextFile(const std::string& path) const;
+
+private:
+    enum class MetricType {
+        COUNTER,
+        GAUGE,
+        HISTOGRAM,
+    };
+
+    struct HistogramGroup {
+        HistogramsFunction histograms;
+    };
+
+    struct Series {
+        Labels labels;
+        std::unique_ptr<Counter> counter;
+        ValueFunction value;
+        HistogramFunction histogram;
+        // ряд группы AddHistograms и его номер в ней
+        std::shared_ptr<const HistogramGroup> group;
+        size_t group_index = 0;
+    };
+
+    struct Family {
+        std::string name;
+        std::string help;
+        MetricType type;
+        std::vector<Series> series;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Family> families_;  // в порядке регистрации
+
+    Series& AddSeries(const std::string& name, const std::string& help, MetricType type, Labels labels);
+    static void RenderHistogram(std::ostream& output, const Family& family, const Series& series,
+                                const LatencyHistogram& histogram);
+};
@@ -0,0 +1,108 @@
+#include "pair_posting_cache.h"
+
+#include <algorithm>
+
+PairPostingCache::PairPostingCache(size_t memory_budget, uint32_t admission_threshold)
+        : memory_budget_(memory_budget)
+        , admission_threshold_(std::max<uint32_t>(admission_threshold, 1)) {
+}
+
+void PairPostingCache::Clear() {
+    std::lock_guard guard(mutex_);
+    entries_.clear();
+    index_.clear();
+    frequencies_.clear();
+    memory_bytes_ = 0;
+}
+
+PairPostingCache::Statistics PairPostingCache::GetStatistics() const {
+    std::lock_guard guard(mutex_);
+    Statistics statistics = statistics_;
+    statistics.size = entries_.size();
+    statistics.memory_bytes = memory_bytes_;
+    return statistics;
+}
+
+std::unique_ptr<PairPostingCache> PairPostingCache::CloneEmpty() const {
+    return std::make_unique<PairPostingCache>(memory_budget_, admission_threshold_);
+}
+
+std::string PairPostingCache::MakeKey(std::string_view first, std::string_view second) {
+    if (second < first) {
+        std::swap(first, second);
+    }
+    //в словах не бывает управляющих символов, поэтому '\0' однозначно разделяет слова пары
+    std::string key;
+    key.reserve(first.size() + second.size() + 1);
+    key.append(first);
+    key.push_back('\0');
+    key.append(second);
+    return key;
+}
+
+size_t PairPostingCache::EstimateBytes(const std::string& key, const Postings& postings) {
+    return sizeof(Entry) + key.size() + postings.capacity() * sizeof(Postings::value_type);
+}
+
+PairPostingCache::Lookup PairPostingCache::FindOrCount(const std::string& key, uint64_t generation) {
+    std::lock_guard guard(mutex_);
+    const auto it = index_.find(key);
+    if (it != index_.end()) {
+        if (it->second->generation == generation) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            ++statistics_.hits;
+            return {it->second->postings, false};
+        }
+        //запись посчитана для другого состояния индекса; пара по-прежнему частая и строится заново
+        memory_bytes_ -= it->second->bytes;
+        entries_.erase(it->second);
+        index_.erase(it);
+        ++statistics_.misses;
+        return {nullptr, true};
+    }
+    ++statistics_.misses;
+    if (frequencies_.size() >= MAX_TRACKED_PAIRS && frequencies_.count(key) == 0) {
+        AgeFrequencies();
+    }
+    uint32_t& frequency = frequencies_[key];
+    ++frequency;
+    return {nullptr, frequency >= admission_threshold_};
+}
+
+void PairPostingCache::Insert(const std::string& key, uint64_t generation, std::shared_ptr<const Postings> postings) {
+    const size_t bytes = EstimateBytes(key, *postings);
+    std::lock_guard guard(mutex_);
+    //пара больше всего бюджета вытеснила бы весь кеш и все равно не поместилась
+    if (bytes > memory_budget_) {
+        frequencies_.erase(key);
+        return;
+    }
+    //пару мог успеть построить параллельный запрос
+    if (const auto it = index_.find(key); it != index_.end()) {
+        memory_bytes_ -= it->second->bytes;
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+    entries_.push_front(Entry{key, generation, std::move(postings), bytes});
+    index_.emplace(key, entries_.begin());
+    memory_bytes_ += bytes;
+    ++statistics_.admissions;
+    while (memory_bytes_ > memory_budget_) {
+        const Entry& victim = entries_.back();
+        memory_bytes_ -= victim.bytes;
+        index_.erase(victim.key);
+        entries_.pop_back();
+        ++statistics_.evictions;
+    }
+}
+
+void PairPostingCache::AgeFrequencies() {
+    for (auto it = frequencies_.begin(); it != frequencies_.end();) {
+        it->second /= 2;
+        if (it->second == 0) {
+            it = frequencies_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
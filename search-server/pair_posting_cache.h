@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Кеш постингов для пар плюс-слов, часто встречающихся вместе в запросах. Для пары хранится
+ * объединение постингов обоих слов с уже сложенным вкладом в релевантность (tf*idf первого слова
+ * плюс tf*idf второго), и вычисление запроса проходит один список вместо двух.
+ * Пара попадает в кеш, когда встретилась в admission_threshold запросах; суммарный размер
+ * записей ограничен memory_budget байтами, при переполнении вытесняются давно не использованные пары.
+ * Записи привязаны к поколению индекса: после изменения корпуса idf другие, и пара строится заново.
+ */
+class PairPostingCache {
+public:
+    // пары (id документа, сумма вкладов слов пары), по возрастанию id
+    using Postings = std::vector<std::pair<int, double>>;
+
+    struct Statistics {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t admissions = 0;
+        uint64_t evictions = 0;
+        size_t size = 0;
+        size_t memory_bytes = 0;
+    };
+
+    explicit PairPostingCache(size_t memory_budget, uint32_t admission_threshold = 3);
+
+    /*
+     * Учитывает, что пара first, second встретилась в запросе, и возвращает ее постинги или nullptr.
+     * Если пара не закеширована, но встречается достаточно часто, постинги строятся вызовом build().
+     */
+    template <typename Builder>
+    std::shared_ptr<const Postings> Acquire(std::string_view first, std::string_view second, uint64_t generation,
+                                            Builder build);
+
+    void Clear();
+
+    [[nodiscard]] Statistics GetStatistics() const;
+    // пустой кеш с теми же настройками
+    [[nodiscard]] std::unique_ptr<PairPostingCache> CloneEmpty() const;
+
+private:
+    //число отслеживаемых пар ограничено; при переполнении счетчики делятся пополам, а обнулившиеся удаляются
+    static constexpr size_t MAX_TRACKED_PAIRS = 1 << 16;
+
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::shared_ptr<const Postings> postings;
+        size_t bytes;
+    };
+
+    struct Lookup {
+        std::shared_ptr<const Postings> postings;
+        bool admit = false;
+    };
+
+    size_t memory_budget_;
+    uint32_t admission_threshold_;
+
+    mutable std::mutex mutex_;
+    std::list<Entry> entries_;  // в начале - недавно использованные
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    std::unordered_map<std::string, uint32_t> frequencies_;
+    size_t memory_bytes_ = 0;
+    Statistics statistics_;
+
+    static std::string MakeKey(std::string_view first, std::string_view second);
+    static size_t EstimateBytes(const std::string& key, const Postings& postings);
+
+    Lookup FindOrCount(const std::string& key, uint64_t generation);
+    void Insert(const std::string& key, uint64_t generation, std::shared_ptr<const Postings> postings);
+    void AgeFrequencies();
+};
+
+template <typename Builder>
+std::shared_ptr<const PairPostingCache::Postings> PairPostingCache::Acquire(std::string_view first,
+                                                                            std::string_view second,
+                                                                            uint64_t generation, Builder build) {
+    const std::string key = MakeKey(first, second);
+    Lookup lookup = FindOrCount(key, generation);
+    if (lookup.postings || !lookup.admit) {
+        return std::move(lookup.postings);
+    }
+    //постинги строим без блокировки: остальные запросы в это время работают с кешем
+    auto postings = std::make_shared<const Postings>(build());
+    Insert(key, generation, postings);
+    return postings;
+}
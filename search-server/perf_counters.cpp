@@ -0,0 +1,201 @@
+#include "perf_counters.h"
+
+#include <iomanip>
+
+#include "stage_timings.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+using namespace std::literals;
+
+PerfValues& PerfValues::operator+=(const PerfValues& other) {
+    cycles += other.cycles;
+    instructions += other.instructions;
+    cache_misses += other.cache_misses;
+    branch_misses += other.branch_misses;
+    return *this;
+}
+
+PerfValues PerfValues::operator-(const PerfValues& other) const {
+    return {cycles - other.cycles, instructions - other.instructions, cache_misses - other.cache_misses,
+            branch_misses - other.branch_misses};
+}
+
+namespace {
+
+constexpr size_t COUNTER_COUNT = 4;
+
+struct StageAccumulator {
+    std::atomic<uint64_t> samples = 0;
+    std::array<std::atomic<uint64_t>, COUNTER_COUNT> values = {};
+};
+
+std::array<StageAccumulator, QUERY_STAGE_COUNT> stage_accumulators;
+
+#if defined(__linux__)
+/* Группа счетчиков потока: первый открытый счетчик - лидер, остальные читаются вместе с ним
+ * одним вызовом read. Счетчик, который процессор или система не поддерживают, пропускается
+ */
+class ThreadPerfGroup {
+public:
+    ThreadPerfGroup() {
+        //порядок совпадает с полями PerfValues
+        const std::array<std::pair<uint32_t, uint64_t>, COUNTER_COUNT> counters = {{
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        }};
+        for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = counters[counter].first;
+            attr.config = counters[counter].second;
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.disabled = leader_ < 0 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            const auto fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0));
+            if (fd < 0) {
+                continue;
+            }
+            if (leader_ < 0) {
+                leader_ = fd;
+            } else {
+                member_fds_[member_count_++] = fd;
+            }
+            group_order_[group_size_++] = counter;
+        }
+        if (leader_ >= 0) {
+            ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    ThreadPerfGroup(const ThreadPerfGroup&) = delete;
+    ThreadPerfGroup& operator=(const ThreadPerfGroup&) = delete;
+
+    ~ThreadPerfGroup() {
+        for (size_t i = 0; i < member_count_; ++i) {
+            close(member_fds_[i]);
+        }
+        if (leader_ >= 0) {
+            close(leader_);
+        }
+    }
+
+    std::optional<PerfValues> Read() const {
+        if (leader_ < 0) {
+            return std::nullopt;
+        }
+        //формат PERF_FORMAT_GROUP: число счетчиков, затем их значения в порядке открытия
+        std::array<uint64_t, COUNTER_COUNT + 1> buffer = {};
+        if (read(leader_, buffer.data(), sizeof(buffer)) < static_cast<ssize_t>(sizeof(uint64_t) * (group_size_ + 1))) {
+            return std::nullopt;
+        }
+        std::array<uint64_t, COUNTER_COUNT> values = {};
+        for (size_t i = 0; i < group_size_; ++i) {
+            values[group_order_[i]] = buffer[i + 1];
+        }
+        return PerfValues{values[0], values[1], values[2], values[3]};
+    }
+
+private:
+    int leader_ = -1;
+    std::array<int, COUNTER_COUNT> member_fds_ = {};
+    size_t member_count_ = 0;
+    std::array<size_t, COUNTER_COUNT> group_order_ = {};
+    size_t group_size_ = 0;
+};
+
+const ThreadPerfGroup& GetThreadGroup() {
+    thread_local const ThreadPerfGroup group;
+    return group;
+}
+#endif
+
+}  // namespace
+
+std::atomic<bool> PerfCounters::enabled_ = false;
+
+bool PerfCounters::Enable() {
+    if (!ReadThread()) {
+        return false;
+    }
+    enabled_.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void PerfCounters::Disable() {
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+std::optional<PerfValues> PerfCounters::ReadThread() {
+#if defined(__linux__)
+    return GetThreadGroup().Read();
+#else
+    return std::nullopt;
+#endif
+}
+
+void PerfCounters::Record(QueryStage stage, const PerfValues& delta) {
+    StageAccumulator& accumulator = stage_accumulators[static_cast<size_t>(stage)];
+    accumulator.samples.fetch_add(1, std::memory_order_relaxed);
+    const std::array<uint64_t, COUNTER_COUNT> values = {delta.cycles, delta.instructions, delta.cache_misses,
+                                                        delta.branch_misses};
+    for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+        accumulator.values[counter].fetch_add(values[counter], std::memory_order_relaxed);
+    }
+}
+
+PerfCounters::Report PerfCounters::GetReport() {
+    Report report;
+    for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+        const StageAccumulator& accumulator = stage_accumulators[stage];
+        report[stage].samples = accumulator.samples.load(std::memory_order_relaxed);
+        report[stage].values = {accumulator.values[0].load(std::memory_order_relaxed),
+                                accumulator.values[1].load(std::memory_order_relaxed),
+                                accumulator.values[2].load(std::memory_order_relaxed),
+                                accumulator.values[3].load(std::memory_order_relaxed)};
+    }
+    return report;
+}
+
+void PerfCounters::Reset() {
+    for (StageAccumulator& accumulator : stage_accumulators) {
+        accumulator.samples.store(0, std::memory_order_relaxed);
+        for (auto& value : accumulator.values) {
+            value.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void PerfCounters::PrintReport(std::ostream& output) {
+    const Report report = GetReport();
+    output << std::left << std::setw(14) << "stage"sv << std::right << std::setw(10) << "samples"sv
+           << std::setw(16) << "cycles"sv << std::setw(16) << "instructions"sv << std::setw(8) << "IPC"sv
+           << std::setw(12) << "LLC/1k"sv << std::setw(12) << "branch/1k"sv << '\n';
+    for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+        const StageReport& stage_report = report[stage];
+        const PerfValues& values = stage_report.values;
+        const auto per_instruction = [&values](uint64_t value) {
+            return values.instructions == 0 ? 0.0 : static_cast<double>(value) / static_cast<double>(values.instructions);
+        };
+        output << std::left << std::setw(14) << StageTimings::GetStageName(static_cast<QueryStage>(stage))
+               << std::right << std::setw(10) << stage_report.samples << std::setw(16) << values.cycles
+               << std::setw(16) << values.instructions << std::fixed << std::setprecision(2)
+               << std::setw(8) << (values.cycles == 0 ? 0.0 : static_cast<double>(values.instructions)
+                                                               / static_cast<double>(values.cycles))
+               << std::setw(12) << per_instruction(values.cache_misses) * 1000.0
+               << std::setw(12) << per_instruction(values.branch_misses) * 1000.0 << '\n';
+        output.unsetf(std::ios_base::floatfield);
+    }
+}
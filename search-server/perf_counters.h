@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+
+#include "query_stage.h"
+
+// значения аппаратных счетчиков; счетчик, который не удалось открыть, остается нулем
+struct PerfValues {
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t cache_misses = 0;   // промахи последнего уровня кеша
+    uint64_t branch_misses = 0;
+
+    PerfValues& operator+=(const PerfValues& other);
+    PerfValues operator-(const PerfValues& other) const;
+};
+
+/*
+ * Профилирование аппаратными счетчиками (Linux, perf_event_open), по умолчанию выключено.
+ * После Enable каждый поток при первом замере открывает свою группу счетчиков: такты, инструкции,
+ * промахи LLC и ошибки предсказания переходов, считая только пользовательский код потока.
+ * Области STAGE_TIMER прибавляют приращения счетчиков к своей стадии; для отчета по одному запросу
+ * достаточно разности ReadThread до и после него. Работа, выполненная в других потоках
+ * (параллельные политики, пул потоков), учитывается только в их собственных областях.
+ * Отчет по стадиям строится теми же областями STAGE_TIMER, поэтому в сборке
+ * с -DSEARCH_SERVER_STAGE_TIMINGS=0 он остается пустым и после Enable; ReadThread работает и в ней.
+ */
+class PerfCounters {
+public:
+    struct StageReport {
+        uint64_t samples = 0;
+        PerfValues values;
+    };
+    using Report = std::array<StageReport, QUERY_STAGE_COUNT>;
+
+    /* Включает профилирование, если система разрешает открыть счетчики
+     * (см. /proc/sys/kernel/perf_event_paranoid); иначе возвращает false
+     */
+    static bool Enable();
+    static void Disable();
+    [[nodiscard]] static bool IsEnabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // накопленные значения счетчиков текущего потока; nullopt, если их не удалось открыть
+    [[nodiscard]] static std::optional<PerfValues> ReadThread();
+    static void Record(QueryStage stage, const PerfValues& delta);
+
+    [[nodiscard]] static Report GetReport();
+    static void Reset();
+    // таблица по стадиям: выборки, такты, инструкции, IPC, промахи LLC и ошибки переходов на тысячу инструкций
+    static void PrintReport(std::ostream& output);
+
+private:
+    static std::atomic<bool> enabled_;
+};
@@ -2,7 +2,6 @@
 // Created by Родион Каргаполов on 10.05.2022.
 //
 #include "process_queries.h"
-#include <execution>
 
 /*
  *  Функция ProcessQueries, распараллеливающую обработку нескольких запросов к поисковой системе.
@@ -11,14 +10,15 @@
  */
 std::vector<std::vector<Document>> ProcessQueries(
         const SearchServer& search_server,
-        const std::vector<std::string>& queries) {
+        const std::vector<std::string>& queries,
+        const QueryOptions& options) {
 
-    std::vector<std::vector<Document>> result(queries.size());
-    transform(std::execution::par,
-              queries.begin(), queries.end(),
-              result.begin(),
-              [&search_server](const std::string& queries_) { return search_server.FindTopDocuments(queries_); }
-    );
+    //запросы пакета выполняются вместе: повторы считаются один раз, слова ищутся в индексе один раз
+    const QueryBatchResults batch = search_server.FindTopDocumentsBatch(queries, options);
+    std::vector<std::vector<Document>> result(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        result[i] = batch[i];
+    }
     return result;
 }
 
@@ -32,12 +32,10 @@ std::vector<std::vector<Document>> ProcessQueries(
  * затем для второго и так далее. Количество итераций такого цикла должно быть равно суммарному
  * размеру внутренних векторов, возвращаемых функцией ProcessQueries.
  */
-[[maybe_unused]] std::list<Document> ProcessQueriesJoined(
+[[maybe_unused]] JoinedDocuments ProcessQueriesJoined(
         const SearchServer& search_server,
-        const std::vector<std::string>& queries) {
-    std::list<Document> doc_list;
-    for (const auto& documents : ProcessQueries(search_server, queries)){
-        doc_list.insert(doc_list.end(), documents.begin(), documents.end());
-    }
-    return doc_list;
-}
\ No newline at end of file
+        const std::vector<std::string>& queries,
+        const QueryOptions& options) {
+    //рабочие потоки пакета пишут результаты сразу в общий массив
+    return search_server.FindTopDocumentsBatchJoined(queries, options);
+}
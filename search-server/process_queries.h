@@ -5,7 +5,6 @@
 
 #include <vector>
 #include <string>
-#include <list>
 #include "search_server.h"
 
 /*
@@ -15,7 +14,8 @@
  */
 std::vector<std::vector<Document>> ProcessQueries(
         const SearchServer& search_server,
-        const std::vector<std::string>& queries);
+        const std::vector<std::string>& queries,
+        const QueryOptions& options = {});
 
 /*
  * функцию ProcessQueriesJoined. Она должна, подобно функции ProcessQueries,
@@ -27,6 +27,7 @@ std::vector<std::vector<Document>> ProcessQueries(
  * затем для второго и так далее. Количество итераций такого цикла должно быть равно суммарному
  * размеру внутренних векторов, возвращаемых функцией ProcessQueries.
  */
-[[maybe_unused]] std::list<Document> ProcessQueriesJoined(
+[[maybe_unused]] JoinedDocuments ProcessQueriesJoined(
         const SearchServer& search_server,
-        const std::vector<std::string>& queries);
\ No newline at end of file
+        const std::vector<std::string>& queries,
+        const QueryOptions& options = {});
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "query_batch_results.h"
+
+QueryBatchResults::QueryBatchResults(std::vector<std::vector<Document>> distinct_results,
+                                     std::vector<size_t> query_to_distinct)
+        : distinct_results_(std::move(distinct_results))
+        , query_to_distinct_(std::move(query_to_distinct)) {
+}
+
+size_t QueryBatchResults::size() const {
+    return query_to_distinct_.size();
+}
+
+const std::vector<Document>& QueryBatchResults::operator[](size_t query) const {
+    return distinct_results_[query_to_distinct_[query]];
+}
+
+JoinedDocuments::QueryDocuments::QueryDocuments(const_iterator begin, const_iterator end)
+        : begin_(begin)
+        , end_(end) {
+}
+
+JoinedDocuments::const_iterator JoinedDocuments::QueryDocuments::begin() const {
+    return begin_;
+}
+
+JoinedDocuments::const_iterator JoinedDocuments::QueryDocuments::end() const {
+    return end_;
+}
+
+size_t JoinedDocuments::QueryDocuments::size() const {
+    return end_ - begin_;
+}
+
+bool JoinedDocuments::QueryDocuments::empty() const {
+    return begin_ == end_;
+}
+
+const Document& JoinedDocuments::QueryDocuments::operator[](size_t index) const {
+    return begin_[index];
+}
+
+JoinedDocuments::JoinedDocuments(std::vector<Document> documents, std::vector<size_t> offsets)
+        : documents_(std::move(documents))
+        , offsets_(std::move(offsets)) {
+}
+
+JoinedDocuments::const_iterator JoinedDocuments::begin() const {
+    return documents_.begin();
+}
+
+JoinedDocuments::const_iterator JoinedDocuments::end() const {
+    return documents_.end();
+}
+
+size_t JoinedDocuments::size() const {
+    return documents_.size();
+}
+
+bool JoinedDocuments::empty() const {
+    return documents_.empty();
+}
+
+size_t JoinedDocuments::GetQueryCount() const {
+    return offsets_.size() - 1;
+}
+
+JoinedDocuments::QueryDocuments JoinedDocuments::operator[](size_t query) const {
+    return {documents_.begin() + offsets_[query], documents_.begin() + offsets_[query + 1]};
+}
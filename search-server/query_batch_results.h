@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+
+#include "document.h"
+
+/*
+ * Результаты пакета запросов. Одинаковые запросы пакета выполняются один раз
+ * и ссылаются на один и тот же результат, поэтому результаты не копируются на каждый запрос.
+ */
+class QueryBatchResults {
+public:
+    QueryBatchResults() = default;
+    // query_to_distinct[i] - номер результата i-го запроса в distinct_results
+    QueryBatchResults(std::vector<std::vector<Document>> distinct_results, std::vector<size_t> query_to_distinct);
+
+    // число запросов пакета
+    [[nodiscard]] size_t size() const;
+    // результат i-го запроса
+    const std::vector<Document>& operator[](size_t query) const;
+
+private:
+    std::vector<std::vector<Document>> distinct_results_;
+    std::vector<size_t> query_to_distinct_;
+};
+
+/*
+ * Результаты нескольких запросов в одном непрерывном массиве: сначала документы первого запроса,
+ * затем второго и так далее. Границы результатов запросов хранятся смещениями.
+ */
+class JoinedDocuments {
+public:
+    using const_iterator = std::vector<Document>::const_iterator;
+
+    // документы одного запроса
+    class QueryDocuments {
+    public:
+        QueryDocuments(const_iterator begin, const_iterator end);
+
+        [[nodiscard]] const_iterator begin() const;
+        [[nodiscard]] const_iterator end() const;
+        [[nodiscard]] size_t size() const;
+        [[nodiscard]] bool empty() const;
+        const Document& operator[](size_t index) const;
+
+    private:
+        const_iterator begin_;
+        const_iterator end_;
+    };
+
+    JoinedDocuments() = default;
+    // offsets[i] - начало результата i-го запроса в documents, offsets.back() == documents.size()
+    JoinedDocuments(std::vector<Document> documents, std::vector<size_t> offsets);
+
+    [[nodiscard]] const_iterator begin() const;
+    [[nodiscard]] const_iterator end() const;
+    // общее число документов всех запросов
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] bool empty() const;
+
+    [[nodiscard]] size_t GetQueryCount() const;
+    // документы i-го запроса
+    QueryDocuments operator[](size_t query) const;
+
+private:
+    std::vector<Document> documents_;
+    std::vector<size_t> offsets_ = {0};
+};
@@ -0,0 +1,89 @@
+#include "query_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+QueryResultCache::QueryResultCache(size_t capacity, size_t shard_count)
+        : capacity_(capacity)
+        , shards_(std::max<size_t>(shard_count, 1)) {
+    shard_capacity_ = std::max<size_t>(1, (capacity_ + shards_.size() - 1) / shards_.size());
+}
+
+std::optional<std::vector<Document>> QueryResultCache::Find(const std::string& key, uint64_t generation) {
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        ++misses_;
+        return std::nullopt;
+    }
+    //запись посчитана для другого состояния индекса
+    if (it->second->generation != generation) {
+        shard.entries.erase(it->second);
+        shard.index.erase(it);
+        ++misses_;
+        return std::nullopt;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    ++hits_;
+    return it->second->documents;
+}
+
+bool QueryResultCache::Contains(const std::string& key, uint64_t generation) const {
+    const Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    const auto it = shard.index.find(key);
+    return it != shard.index.end() && it->second->generation == generation;
+}
+
+void QueryResultCache::Insert(const std::string& key, uint64_t generation, std::vector<Document> documents) {
+    if (capacity_ == 0) {
+        return;
+    }
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        it->second->generation = generation;
+        it->second->documents = std::move(documents);
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    shard.entries.push_front(Entry{key, generation, std::move(documents)});
+    shard.index.emplace(key, shard.entries.begin());
+    if (shard.entries.size() > shard_capacity_) {
+        shard.index.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+}
+
+void QueryResultCache::Clear() {
+    for (Shard& shard : shards_) {
+        std::lock_guard guard(shard.mutex);
+        shard.index.clear();
+        shard.entries.clear();
+    }
+}
+
+QueryResultCache::Statistics QueryResultCache::GetStatistics() const {
+    Statistics statistics;
+    statistics.hits = hits_.load();
+    statistics.misses = misses_.load();
+    for (const Shard& shard : shards_) {
+        std::lock_guard guard(shard.mutex);
+        statistics.size += shard.entries.size();
+    }
+    return statistics;
+}
+
+std::unique_ptr<QueryResultCache> QueryResultCache::CloneEmpty() const {
+    return std::make_unique<QueryResultCache>(capacity_, shards_.size());
+}
+
+QueryResultCache::Shard& QueryResultCache::GetShard(const std::string& key) {
+    return shards_[std::hash<std::string>{}(key) % shards_.size()];
+}
+
+const QueryResultCache::Shard& QueryResultCache::GetShard(const std::string& key) const {
+    return shards_[std::hash<std::string>{}(key) % shards_.size()];
+}
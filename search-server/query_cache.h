@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+
+/*
+ * Кеш результатов FindTopDocuments: шардированный LRU с блокировкой на шард.
+ * Ключ - нормализованный запрос (отсортированные плюс- и минус-слова без повторов), фильтр,
+ * параметры запроса и политика выполнения. Запись хранит поколение индекса, при котором она получена:
+ * после AddDocument/RemoveDocument поколение меняется, и старые записи считаются промахом.
+ */
+class QueryResultCache {
+public:
+    struct Statistics {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t size = 0;
+    };
+
+    explicit QueryResultCache(size_t capacity, size_t shard_count = 16);
+
+    std::optional<std::vector<Document>> Find(const std::string& key, uint64_t generation);
+    void Insert(const std::string& key, uint64_t generation, std::vector<Document> documents);
+    // есть ли действительная запись; в отличие от Find не меняет порядок LRU и счетчики
+    [[nodiscard]] bool Contains(const std::string& key, uint64_t generation) const;
+    void Clear();
+
+    [[nodiscard]] Statistics GetStatistics() const;
+    // пустой кеш с теми же емкостью и числом шардов
+    [[nodiscard]] std::unique_ptr<QueryResultCache> CloneEmpty() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> entries;  // в начале - недавно использованные
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    };
+
+    size_t capacity_;
+    size_t shard_capacity_;
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+
+    Shard& GetShard(const std::string& key);
+    const Shard& GetShard(const std::string& key) const;
+};
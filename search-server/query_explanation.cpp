@@ -0,0 +1,44 @@
+#include "query_explanation.h"
+
+#include "stage_timings.h"
+
+using namespace std::literals;
+
+std::ostream& operator<<(std::ostream& out, const QueryExplanation& explanation) {
+    out << "terms:"sv << std::endl;
+    for (const QueryExplanation::Term& term : explanation.terms) {
+        out << "  "sv << (term.is_minus ? "-"sv : ""sv) << term.word << ": postings = "sv << term.posting_count;
+        if (!term.is_minus) {
+            out << ", idf = "sv << term.inverse_document_freq;
+        }
+        out << std::endl;
+    }
+    const QueryExplanation::WorkCounters& work = explanation.work;
+    out << "work: postings_scanned = "sv << work.postings_scanned
+        << ", minus_exclusions = "sv << work.minus_exclusions
+        << ", predicate_evaluations = "sv << work.predicate_evaluations
+        << ", excluded_documents = "sv << work.excluded_documents
+        << ", candidate_documents = "sv << work.candidate_documents
+        << ", pair_units = "sv << work.pair_units << std::endl;
+    if (explanation.result_cached) {
+        out << "result cached"sv << std::endl;
+    }
+    out << "documents:"sv << std::endl;
+    for (const QueryExplanation::DocumentScore& score : explanation.top_documents) {
+        out << "  "sv << score.document << std::endl;
+        for (const QueryExplanation::TermContribution& contribution : score.contributions) {
+            out << "    "sv << contribution.word << ": tf = "sv << contribution.term_freq
+                << ", relevance = "sv << contribution.relevance << std::endl;
+        }
+    }
+    out << "stages:"sv;
+    for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+        if (static_cast<QueryStage>(stage) == QueryStage::INGEST) {
+            continue;
+        }
+        out << ' ' << StageTimings::GetStageName(static_cast<QueryStage>(stage)) << " = "sv
+            << explanation.stage_durations[stage].count() << " ns"sv;
+    }
+    out << std::endl;
+    return out;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "document.h"
+#include "query_stage.h"
+
+/*
+ * Разбор выполнения одного запроса (SearchServer::ExplainQuery): слова запроса с их idf и длиной
+ * списков документов, счетчики проделанной работы, вклад каждого слова в релевантность
+ * найденных документов и время стадий.
+ */
+struct QueryExplanation {
+    struct Term {
+        std::string word;
+        bool is_minus = false;
+        double inverse_document_freq = 0.0;  // для минус-слов не используется
+        size_t posting_count = 0;            // документов со словом
+    };
+
+    struct TermContribution {
+        std::string word;
+        double term_freq = 0.0;
+        double relevance = 0.0;  // term_freq * idf
+    };
+
+    struct DocumentScore {
+        Document document;
+        std::vector<TermContribution> contributions;  // только слова, встречающиеся в документе
+    };
+
+    /* Счетчики работы того пути вычисления, которым запрос выполнил бы FindTopDocuments.
+     * При impact_ordered минус-слова и фильтр проверяются один раз на документ, а не на постинг
+     */
+    struct WorkCounters {
+        uint64_t postings_scanned = 0;       // просмотрено постингов плюс-слов и пар
+        uint64_t minus_exclusions = 0;       // постингов отброшено из-за минус-слов
+        uint64_t predicate_evaluations = 0;  // проверок фильтра документа
+        uint64_t excluded_documents = 0;     // документов, содержащих минус-слова
+        uint64_t candidate_documents = 0;    // документов, получивших релевантность
+        uint64_t pair_units = 0;             // пар слов, посчитанных по постингам из кеша пар
+    };
+
+    std::vector<Term> terms;
+    WorkCounters work;
+    // FindTopDocuments с теми же аргументами ответил бы из кеша результатов
+    bool result_cached = false;
+    std::vector<DocumentScore> top_documents;
+    // время стадий QueryStage; INGEST не используется, при сборке без замеров стадий - нули
+    std::array<std::chrono::nanoseconds, QUERY_STAGE_COUNT> stage_durations = {};
+};
+
+std::ostream& operator<<(std::ostream& out, const QueryExplanation& explanation);
@@ -0,0 +1,49 @@
+#include "query_interruption.h"
+
+using namespace std::string_literals;
+
+QueryInterruptedError::QueryInterruptedError(QueryStatus status)
+        : std::runtime_error(status == QueryStatus::CANCELLED ? "Запрос отменен"s : "Истек срок выполнения запроса"s)
+        , status_(status) {
+}
+
+QueryStatus QueryInterruptedError::GetStatus() const {
+    return status_;
+}
+
+QueryInterruption::QueryInterruption(const QueryOptions& options)
+        : options_(options) {
+}
+
+bool QueryInterruption::IsEnabled() const {
+    return options_.deadline.has_value() || options_.cancellation.has_value();
+}
+
+bool QueryInterruption::ShouldStop() {
+    if (status_.load(std::memory_order_relaxed) != QueryStatus::COMPLETE) {
+        return true;
+    }
+    if (options_.cancellation && options_.cancellation->IsCancelled()) {
+        status_.store(QueryStatus::CANCELLED, std::memory_order_relaxed);
+        return true;
+    }
+    if (options_.deadline && std::chrono::steady_clock::now() >= *options_.deadline) {
+        status_.store(QueryStatus::DEADLINE_EXCEEDED, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+QueryStatus QueryInterruption::GetStatus() const {
+    return status_.load(std::memory_order_relaxed);
+}
+
+void QueryInterruption::Finish() const {
+    const QueryStatus status = GetStatus();
+    if (options_.status != nullptr) {
+        *options_.status = status;
+    }
+    if (status != QueryStatus::COMPLETE && !options_.allow_partial) {
+        throw QueryInterruptedError(status);
+    }
+}
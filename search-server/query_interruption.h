@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <stdexcept>
+
+#include "query_options.h"
+
+// запрос прерван по сроку или отмене, а частичный результат не разрешен
+class QueryInterruptedError : public std::runtime_error {
+public:
+    explicit QueryInterruptedError(QueryStatus status);
+
+    [[nodiscard]] QueryStatus GetStatus() const;
+
+private:
+    QueryStatus status_;
+};
+
+/*
+ * Проверка срока и отмены одного запроса. Циклы начисления релевантности вызывают ShouldStop
+ * раз в POSTINGS_PER_CHECK постингов; прерывание, однажды обнаруженное, видно всем потокам запроса.
+ */
+class QueryInterruption {
+public:
+    static constexpr size_t POSTINGS_PER_CHECK = 1024;
+
+    explicit QueryInterruption(const QueryOptions& options);
+
+    // true, если у запроса есть срок или токен отмены
+    [[nodiscard]] bool IsEnabled() const;
+    // true, если вычисление пора прекратить
+    bool ShouldStop();
+    [[nodiscard]] QueryStatus GetStatus() const;
+
+    /* Записывает итог в options.status и, если запрос прерван без разрешения на частичный
+     * результат, выбрасывает QueryInterruptedError
+     */
+    void Finish() const;
+
+private:
+    const QueryOptions& options_;
+    std::atomic<QueryStatus> status_ = QueryStatus::COMPLETE;
+};
@@ -0,0 +1,13 @@
+#include "query_options.h"
+
+CancellationToken::CancellationToken()
+        : cancelled_(std::make_shared<std::atomic<bool>>(false)) {
+}
+
+void CancellationToken::Cancel() const {
+    cancelled_->store(true, std::memory_order_relaxed);
+}
+
+bool CancellationToken::IsCancelled() const {
+    return cancelled_->load(std::memory_order_relaxed);
+}
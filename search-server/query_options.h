@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+
+const int MAX_RESULT_DOCUMENT_COUNT = 5;
+
+// чем закончилось вычисление запроса
+enum class QueryStatus {
+    COMPLETE,
+    DEADLINE_EXCEEDED,
+    CANCELLED,
+};
+
+/*
+ * Флаг отмены запроса. Копии токена разделяют один флаг: вызывающий оставляет копию себе,
+ * передает другую в QueryOptions и может отменить запрос из другого потока.
+ */
+class CancellationToken {
+public:
+    CancellationToken();
+
+    void Cancel() const;
+    [[nodiscard]] bool IsCancelled() const;
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+/*
+ * Параметры выполнения одного поискового запроса.
+ * Передаются последним аргументом во все перегрузки FindTopDocuments и в ProcessQueries.
+ */
+struct QueryOptions {
+    // сколько лучших документов вернуть; под это число подбирается и отбор top-k
+    int limit = MAX_RESULT_DOCUMENT_COUNT;
+    // вычислять запрос по постингам, упорядоченным по вкладу в релевантность, с ранней остановкой
+    bool impact_ordered = false;
+    // для impact_ordered: остановиться после просмотра стольких постингов (приближенный результат), 0 - без ограничения
+    size_t postings_budget = 0;
+    /* Срок и отмена проверяются при начислении релевантности после каждого блока постингов.
+     * Прерванный запрос выбрасывает QueryInterruptedError, а с allow_partial возвращает лучшие документы
+     * из уже просмотренных. Такие результаты не кешируются
+     */
+    std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt;
+    std::optional<CancellationToken> cancellation = std::nullopt;
+    bool allow_partial = false;
+    // если задан, сюда записывается, завершилось ли вычисление полностью
+    QueryStatus* status = nullptr;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+// стадии, по которым замеряется работа сервера (StageTimings, PerfCounters)
+enum class QueryStage {
+    PARSE,         // разбор текста запроса на плюс- и минус-слова
+    LOOKUP,        // поиск слов в индексе, idf, план обхода постингов
+    MINUS_FILTER,  // сбор документов с минус-словами
+    SCORE,         // обход постингов и начисление релевантности
+    SELECT,        // отбор и сортировка top-k
+    INGEST,        // не стадия запроса: добавление документов в индекс
+};
+
+inline constexpr size_t QUERY_STAGE_COUNT = 6;
@@ -2,43 +2,27 @@
 
 //public:
 RequestQueue::RequestQueue(const SearchServer& search_server)
-        : search_server_(search_server)
-        , no_results_requests_(0)
-        , current_time_(0) {
+        : search_server_(search_server) {
 
 }
 
-[[maybe_unused]] std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-    const auto matched_documents = search_server_.FindTopDocuments(raw_query, status);
-    PutRequestIntoQueue(matched_documents.size());
+[[maybe_unused]] std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status,
+                                                                     const QueryOptions& options) {
+    const auto start_time = RequestStatistics::Clock::now();
+    const auto matched_documents = search_server_.FindTopDocuments(raw_query, status, options);
+    const auto end_time = RequestStatistics::Clock::now();
+    statistics_.Record(matched_documents.size(), end_time - start_time, end_time);
     return matched_documents;
 }
 
-std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
-    const auto matched_documents = search_server_.FindTopDocuments(raw_query);
-    PutRequestIntoQueue(matched_documents.size());
-    return matched_documents;
+std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, const QueryOptions& options) {
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL, options);
 }
 
 [[maybe_unused]] int RequestQueue::GetNoResultRequests() const {
-    return no_results_requests_;
+    return static_cast<int>(statistics_.GetSummary(RequestStatistics::Window::DAY).no_result_requests);
 }
 
-
-//private:
-void RequestQueue::PutRequestIntoQueue(int results_num) {
-    // новый запрос - новая секунда
-    ++current_time_;
-    // удаляем все результаты поиска, которые устарели
-    while (!requests_.empty() && min_in_day_ <= current_time_ - requests_.front().timestamp) {
-        if (0 == requests_.front().results) {
-            --no_results_requests_;
-        }
-        requests_.pop_front();
-    }
-    // сохраняем новый результат поиска
-    requests_.push_back({current_time_, results_num});
-    if (0 == results_num) {
-        ++no_results_requests_;
-    }
-}
\ No newline at end of file
+RequestStatistics::Summary RequestQueue::GetStatistics(RequestStatistics::Window window) const {
+    return statistics_.GetSummary(window);
+}
@@ -1,43 +1,46 @@
 #pragma once
 
-#include <deque>
+#include <chrono>
 #include <vector>
 #include "document.h"
 #include "search_server.h"
+#include "request_statistics.h"
 
+/*
+ * Поисковые запросы со статистикой за последнюю минуту, час и сутки: число запросов,
+ * запросов без результатов и распределение длительностей. AddFindRequest можно вызывать
+ * из нескольких потоков одновременно.
+ */
 class RequestQueue {
 public:
     explicit RequestQueue(const SearchServer &search_server);
 
     template<typename DocumentPredicate>
-    [[maybe_unused]] std::vector<Document> AddFindRequest(const std::string &raw_query, DocumentPredicate document_predicate);
+    [[maybe_unused]] std::vector<Document> AddFindRequest(const std::string &raw_query, DocumentPredicate document_predicate,
+                                                          const QueryOptions& options = {});
 
-    [[maybe_unused]] std::vector<Document> AddFindRequest(const std::string &raw_query, DocumentStatus status);
+    [[maybe_unused]] std::vector<Document> AddFindRequest(const std::string &raw_query, DocumentStatus status,
+                                                          const QueryOptions& options = {});
 
-    [[maybe_unused]] std::vector<Document> AddFindRequest(const std::string &raw_query);
+    [[maybe_unused]] std::vector<Document> AddFindRequest(const std::string &raw_query, const QueryOptions& options = {});
 
+    // запросы без результатов за последние сутки
     [[maybe_unused]] [[nodiscard]] int GetNoResultRequests() const;
 
-private:
-    struct QueryResult {
-        uint64_t timestamp;
-        int results;
-    };
+    [[nodiscard]] RequestStatistics::Summary GetStatistics(RequestStatistics::Window window) const;
 
-    std::deque<QueryResult> requests_;
+private:
     const SearchServer& search_server_;
-    int no_results_requests_;
-    uint64_t current_time_;
-    const static int min_in_day_ = 1440;
-
-    void PutRequestIntoQueue(int results_num);
+    RequestStatistics statistics_;
 };
 
 //template function realization
 template<typename DocumentPredicate>
-[[maybe_unused]] std::vector<Document> RequestQueue::AddFindRequest(const std::string &raw_query, DocumentPredicate document_predicate) {
-    // напишите реализацию
-    const auto matched_documents = search_server_.FindTopDocuments(raw_query, document_predicate);
-    RequestQueue::PutRequestIntoQueue(matched_documents.size());
+[[maybe_unused]] std::vector<Document> RequestQueue::AddFindRequest(const std::string &raw_query, DocumentPredicate document_predicate,
+                                                                     const QueryOptions& options) {
+    const auto start_time = RequestStatistics::Clock::now();
+    const auto matched_documents = search_server_.FindTopDocuments(raw_query, document_predicate, options);
+    const auto end_time = RequestStatistics::Clock::now();
+    statistics_.Record(matched_documents.size(), end_time - start_time, end_time);
     return matched_documents;
-}
\ No newline at end of file
+}
@@ -0,0 +1,111 @@
+#include "request_statistics.h"
+
+#include <algorithm>
+#include <thread>
+
+using namespace std::literals;
+
+namespace {
+
+//длительность корзины и число корзин окон MINUTE, HOUR, DAY, TOTAL; 0s - корзина без срока
+constexpr std::array<std::pair<std::chrono::seconds, size_t>, RequestStatistics::WINDOW_COUNT> WINDOW_RINGS = {{
+        {5s, 12},
+        {5min, 12},
+        {1h, 24},
+        {0s, 1},
+}};
+
+constexpr size_t MAX_DEFAULT_SHARDS = 16;
+
+std::atomic<size_t> next_thread_index = 0;
+
+}  // namespace
+
+RequestStatistics::RequestStatistics(size_t shard_count, Clock::time_point origin)
+        : origin_(origin) {
+    if (shard_count == 0) {
+        shard_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, MAX_DEFAULT_SHARDS);
+    }
+    shards_.resize(shard_count);
+    for (Shard& shard : shards_) {
+        for (size_t window = 0; window < WINDOW_RINGS.size(); ++window) {
+            const auto [slot_duration, slot_count] = WINDOW_RINGS[window];
+            //при бесконечной длительности номер интервала всегда 0, и корзина не обнуляется
+            const Clock::duration duration = slot_duration == 0s ? Clock::duration::max() : Clock::duration(slot_duration);
+            shard.rings[window] = {duration, std::make_unique<Slot[]>(slot_count), slot_count};
+        }
+    }
+}
+
+void RequestStatistics::Record(size_t result_count, Clock::duration latency, Clock::time_point now) {
+    Shard& shard = GetThreadShard();
+    for (Ring& ring : shard.rings) {
+        const int64_t epoch = GetEpoch(ring, now);
+        Slot& slot = ring.slots[static_cast<size_t>(epoch) % ring.slot_count];
+        if (!ClaimSlot(slot, epoch)) {
+            //запись с отставшим временем в уже перезанятую корзину не учитывается
+            continue;
+        }
+        slot.requests.fetch_add(1, std::memory_order_relaxed);
+        if (result_count == 0) {
+            slot.no_result_requests.fetch_add(1, std::memory_order_relaxed);
+        }
+        slot.latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(latency));
+    }
+}
+
+RequestStatistics::Summary RequestStatistics::GetSummary(Window window, Clock::time_point now) const {
+    Summary summary;
+    for (const Shard& shard : shards_) {
+        const Ring& ring = shard.rings[static_cast<size_t>(window)];
+        const int64_t epoch = GetEpoch(ring, now);
+        const auto slot_count = static_cast<int64_t>(ring.slot_count);
+        for (size_t i = 0; i < ring.slot_count; ++i) {
+            const Slot& slot = ring.slots[i];
+            const int64_t slot_epoch = slot.epoch.load(std::memory_order_acquire);
+            if (slot_epoch < 0 || slot_epoch > epoch || slot_epoch <= epoch - slot_count) {
+                continue;
+            }
+            summary.requests += slot.requests.load(std::memory_order_relaxed);
+            summary.no_result_requests += slot.no_result_requests.load(std::memory_order_relaxed);
+            summary.latency.Merge(slot.latency);
+        }
+    }
+    return summary;
+}
+
+//private:
+RequestStatistics::Shard& RequestStatistics::GetThreadShard() {
+    //номер потока выдается при первой записи и общий для всех объектов статистики
+    thread_local const size_t thread_index = next_thread_index.fetch_add(1, std::memory_order_relaxed);
+    return shards_[thread_index % shards_.size()];
+}
+
+bool RequestStatistics::ClaimSlot(Slot& slot, int64_t epoch) {
+    int64_t slot_epoch = slot.epoch.load(std::memory_order_acquire);
+    while (slot_epoch != epoch) {
+        if (slot_epoch == RESETTING_EPOCH) {
+            //другой поток обнуляет корзину: записывать можно только после того, как он опубликует новый интервал
+            std::this_thread::yield();
+            slot_epoch = slot.epoch.load(std::memory_order_acquire);
+            continue;
+        }
+        if (slot_epoch > epoch) {
+            return false;
+        }
+        //корзину с данными прошлого оборота кольца обнуляет тот, кто первым ее занял;
+        //новый интервал публикуется только после обнуления, иначе обнуление стерло бы чужие записи
+        if (slot.epoch.compare_exchange_weak(slot_epoch, RESETTING_EPOCH, std::memory_order_acquire)) {
+            slot.requests.store(0, std::memory_order_relaxed);
+            slot.no_result_requests.store(0, std::memory_order_relaxed);
+            slot.latency.Reset();
+            slot.epoch.store(epoch, std::memory_order_release);
+            return true;
+        }
+    }
+    return true;
+}
+
+int64_t RequestStatistics::GetEpoch(const Ring& ring, Clock::time_point now) const {
+    return std::max<int64_t>((now - origin_) / ring.slot_duration, 0);
+}
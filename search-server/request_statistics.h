@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "latency_histogram.h"
+
+/*
+ * Статистика поисковых запросов за последнюю минуту, час и сутки по реальным часам и за все время.
+ * Каждое окно - кольцо корзин: минута из 12 корзин по 5 секунд, час из 12 корзин по 5 минут,
+ * сутки из 24 часовых корзин; окно сдвигается на целую корзину, а корзина, в которую пришло
+ * новое время, обнуляется. Окно TOTAL - одна корзина, которая не обнуляется: из него берутся
+ * монотонные счетчики для экспорта метрик. В корзине - число запросов, число запросов
+ * без результатов и гистограмма длительностей.
+ *
+ * Record не берет блокировок: у каждого потока свой шард колец с атомарными счетчиками,
+ * GetSummary складывает шарды. Если потоков больше, чем шардов, поток делит шард с другими.
+ * Корзину для нового интервала обнуляет один поток, остальные ждут конца обнуления, поэтому
+ * записи не теряются; не учитывается только запись с отставшим временем, корзину которой
+ * уже занял более поздний интервал.
+ */
+class RequestStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Window {
+        MINUTE,
+        HOUR,
+        DAY,
+        TOTAL,
+    };
+
+    static constexpr size_t WINDOW_COUNT = 4;
+
+    struct Summary {
+        uint64_t requests = 0;
+        uint64_t no_result_requests = 0;
+        LatencyHistogram latency;
+    };
+
+    // по умолчанию шардов столько, сколько аппаратных потоков, но не больше 16
+    explicit RequestStatistics(size_t shard_count = 0, Clock::time_point origin = Clock::now());
+
+    void Record(size_t result_count, Clock::duration latency, Clock::time_point now = Clock::now());
+    [[nodiscard]] Summary GetSummary(Window window, Clock::time_point now = Clock::now()) const;
+
+private:
+    struct Slot {
+        //номер интервала с начала отсчета, данные которого лежат в корзине; -1 - пустая корзина,
+        //RESETTING_EPOCH - корзину обнуляют для нового интервала
+        std::atomic<int64_t> epoch = -1;
+        std::atomic<uint64_t> requests = 0;
+        std::atomic<uint64_t> no_result_requests = 0;
+        LatencyHistogram latency;
+    };
+
+    struct Ring {
+        Clock::duration slot_duration;
+        std::unique_ptr<Slot[]> slots;
+        size_t slot_count;
+    };
+
+    struct alignas(64) Shard {
+        std::array<Ring, WINDOW_COUNT> rings;
+    };
+
+    Clock::time_point origin_;
+    std::vector<Shard> shards_;
+
+    static constexpr int64_t RESETTING_EPOCH = -2;
+
+    [[nodiscard]] Shard& GetThreadShard();
+    // готовит корзину к записи интервала epoch; false, если корзина уже занята более поздним интервалом
+    static bool ClaimSlot(Slot& slot, int64_t epoch);
+    [[nodiscard]] int64_t GetEpoch(const Ring& ring, Clock::time_point now) const;
+};
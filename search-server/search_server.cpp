@@ -1,5 +1,27 @@
 #include "search_server.h"
 
+struct SearchServer::PreparedQuery::State {
+    //разобранный запрос ссылается на raw_query или normalized_query, поэтому состояние не перемещается
+    std::string raw_query;
+    std::string normalized_query;
+    Query query;
+    size_t cost = 0;
+};
+
+SearchServer::PreparedQuery::PreparedQuery(std::unique_ptr<State> state)
+        : state_(std::move(state)) {
+}
+
+SearchServer::PreparedQuery::PreparedQuery(PreparedQuery&&) noexcept = default;
+
+SearchServer::PreparedQuery& SearchServer::PreparedQuery::operator=(PreparedQuery&&) noexcept = default;
+
+SearchServer::PreparedQuery::~PreparedQuery() = default;
+
+size_t SearchServer::PreparedQuery::GetCost() const {
+    return state_->cost;
+}
+
 //public:
 SearchServer::SearchServer(const std::string& stop_words) : SearchServer::SearchServer(SplitIntoWordsView(stop_words)) {}
 
@@ -12,10 +34,60 @@ SearchServer::SearchServer(std::string_view stop_words) : SearchServer::SearchSe
  */
 void SearchServer::AddDocument(int document_id, std::string_view document,
                                DocumentStatus status, const std::vector<int>& ratings) {
+    TRACE_SCOPE("AddDocument");
+    ALLOCATION_SCOPE(AllocatingOperation::ADD_DOCUMENT);
+    STAGE_TIMER(QueryStage::INGEST);
     if ((document_id < 0) || (documents_.count(document_id) > 0)) {
         throw std::invalid_argument("Отрицательный id или id ранее добавленного документа"s);
     }
-    const std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
+    std::string normalized_document;
+    std::vector<std::string_view> stop_words;
+    const std::vector<std::string_view> words = SplitIntoWordsNoStop(NormalizeText(document, normalized_document),
+                                                                     stop_words);
+    InsertDocument(document_id, words, stop_words, status, ratings);
+}
+
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    TRACE_SCOPE("AddDocuments");
+    STAGE_TIMER(QueryStage::INGEST);
+    std::set<int> new_ids;
+    for (const NewDocument& document : documents) {
+        if (document.id < 0 || documents_.count(document.id) > 0 || !new_ids.insert(document.id).second) {
+            throw std::invalid_argument("Отрицательный id или id ранее добавленного документа"s);
+        }
+    }
+    //разбор текста не зависит от индекса и идет параллельно; ошибки собираем, чтобы выбросить их до изменения индекса
+    std::vector<std::string> normalized_documents(documents.size());
+    std::vector<std::vector<std::string_view>> document_words(documents.size());
+    std::vector<std::vector<std::string_view>> document_stop_words(documents.size());
+    std::vector<std::exception_ptr> errors(documents.size());
+    ForEachIndex(std::execution::par, documents.size(), [&](size_t i) {
+        TRACE_SCOPE("ParseDocument");
+        try {
+            document_words[i] = SplitIntoWordsNoStop(NormalizeText(documents[i].text, normalized_documents[i]),
+                                                     document_stop_words[i]);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+    RethrowFirstError(errors);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        InsertDocument(documents[i].id, document_words[i], document_stop_words[i], documents[i].status,
+                       documents[i].ratings);
+    }
+}
+
+void SearchServer::RethrowFirstError(const std::vector<std::exception_ptr>& errors) {
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void SearchServer::InsertDocument(int document_id, const std::vector<std::string_view>& words,
+                                  const std::vector<std::string_view>& stop_words, DocumentStatus status,
+                                  const std::vector<int>& ratings) {
     const double inv_word_count = 1.0 / words.size();
     for (std::string_view word : words) {
         auto [it_word, yes] = dictionary_.emplace(word);
@@ -25,24 +97,436 @@ void SearchServer::AddDocument(int document_id, std::string_view document,
          */
         document_to_word_freqs_[document_id][*it_word] += inv_word_count;
     }
-    documents_.emplace(document_id, DocumentData{SearchServer::ComputeAverageRating(ratings), status});
+    const int rating = SearchServer::ComputeAverageRating(ratings);
+    documents_.emplace(document_id, DocumentData{rating, status});
     document_ids_.insert(document_id);
+    status_to_documents_[status].Add(document_id);
+    rating_to_documents_[rating].Add(document_id);
+    ++ingest_counters_.documents;
+    ingest_counters_.words += words.size() + stop_words.size();
+    for (std::string_view stop_word : stop_words) {
+        //ключ - представление из stop_words_: stop_word указывает на текст документа, который не сохраняется
+        ++stop_word_hits_[*stop_words_.find(stop_word)];
+    }
+    ++index_generation_;
 }
 
 /*Поиск документов по запросу, с учетом статуса
  */
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
-    return SearchServer::FindTopDocuments(std::execution::seq, raw_query, status);
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                                     const QueryOptions& options) const {
+    return SearchServer::FindTopDocuments(std::execution::seq, raw_query, status, options);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, const QueryOptions& options) const {
+    return SearchServer::FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL, options);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter,
+                                                     const QueryOptions& options) const {
+    return SearchServer::FindTopDocuments(std::execution::seq, raw_query, filter, options);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, DocumentStatus status,
+                                                     const QueryOptions& options) const {
+    const DocumentBitmap& status_documents = GetStatusDocuments(status);
+    const std::string filter_key = result_cache_.Get() ? DocumentFilter::Status({status}).ToString() : std::string{};
+    return FindTopDocumentsImpl(std::execution::seq, query, [&status_documents](int document_id) {
+        return status_documents.Contains(document_id);
+    }, filter_key, options);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, const QueryOptions& options) const {
+    return FindTopDocuments(query, DocumentStatus::ACTUAL, options);
+}
+
+QueryBatchResults SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+                                                      const QueryOptions& options) const {
+    TRACE_SCOPE("FindTopDocumentsBatch");
+    std::vector<std::string> normalized_queries;
+    const std::vector<Query> parsed_queries = ParseBatch(raw_queries, normalized_queries);
+    std::vector<const Query*> queries;
+    for (const Query& query : parsed_queries) {
+        queries.push_back(&query);
+    }
+    return CollectBatchResults(queries, options);
+}
+
+QueryBatchResults SearchServer::FindTopDocumentsBatch(const std::vector<PreparedQuery>& queries,
+                                                      const QueryOptions& options) const {
+    TRACE_SCOPE("FindTopDocumentsBatch");
+    std::vector<const Query*> parsed_queries;
+    for (const PreparedQuery& query : queries) {
+        parsed_queries.push_back(&query.state_->query);
+    }
+    return CollectBatchResults(parsed_queries, options);
+}
+
+QueryBatchResults SearchServer::CollectBatchResults(const std::vector<const Query*>& queries,
+                                                    const QueryOptions& options) const {
+    //различных запросов не больше, чем запросов; лишние места отрезаются после выполнения
+    std::vector<std::vector<Document>> distinct_results(queries.size());
+    std::vector<size_t> query_to_distinct = RunBatch(queries, options,
+                                                     [&distinct_results](size_t distinct, size_t,
+                                                                         std::vector<Document> documents) {
+        distinct_results[distinct] = std::move(documents);
+    });
+    distinct_results.resize(query_to_distinct.empty()
+                            ? 0 : *std::max_element(query_to_distinct.begin(), query_to_distinct.end()) + 1);
+    return {std::move(distinct_results), std::move(query_to_distinct)};
+}
+
+JoinedDocuments SearchServer::FindTopDocumentsBatchJoined(const std::vector<std::string>& raw_queries,
+                                                          const QueryOptions& options) const {
+    TRACE_SCOPE("FindTopDocumentsBatchJoined");
+    const size_t query_count = raw_queries.size();
+    //у каждого запроса место под наибольший возможный результат: рабочие потоки пишут в него сразу
+    const size_t capacity = std::min(static_cast<size_t>(std::max(options.limit, 0)),
+                                     GetStatusDocuments(DocumentStatus::ACTUAL).Size());
+    std::vector<std::string> normalized_queries;
+    const std::vector<Query> parsed_queries = ParseBatch(raw_queries, normalized_queries);
+    std::vector<const Query*> queries;
+    for (const Query& query : parsed_queries) {
+        queries.push_back(&query);
+    }
+    std::vector<Document> documents(query_count * capacity);
+    std::vector<size_t> sizes(query_count, 0);
+    const std::vector<size_t> query_to_distinct = RunBatch(queries, options,
+                                                           [&documents, &sizes, capacity](size_t, size_t first_query,
+                                                                                          std::vector<Document> result) {
+        std::move(result.begin(), result.end(), documents.begin() + first_query * capacity);
+        sizes[first_query] = result.size();
+    });
+
+    //сдвигаем результаты к началу; результат повторного запроса копируется из уже сдвинутого первого.
+    //место запроса i начинается с i * capacity, а сдвинутые результаты предыдущих запросов не длиннее,
+    //поэтому запись никогда не затирает еще не сдвинутый результат
+    std::vector<size_t> offsets(query_count + 1, 0);
+    std::vector<size_t> distinct_offsets;
+    std::vector<size_t> distinct_sizes;
+    for (size_t i = 0; i < query_count; ++i) {
+        const size_t distinct = query_to_distinct[i];
+        const auto output = documents.begin() + offsets[i];
+        if (distinct == distinct_offsets.size()) {
+            const auto slot = documents.begin() + i * capacity;
+            std::move(slot, slot + sizes[i], output);
+            distinct_offsets.push_back(offsets[i]);
+            distinct_sizes.push_back(sizes[i]);
+        } else {
+            const auto source = documents.begin() + distinct_offsets[distinct];
+            std::copy(source, source + distinct_sizes[distinct], output);
+        }
+        offsets[i + 1] = offsets[i] + distinct_sizes[distinct];
+    }
+    documents.resize(offsets.back());
+    return {std::move(documents), std::move(offsets)};
+}
+
+std::vector<SearchServer::Query> SearchServer::ParseBatch(const std::vector<std::string>& raw_queries,
+                                                          std::vector<std::string>& normalized_queries) const {
+    const size_t query_count = raw_queries.size();
+    //разобранные запросы ссылаются на normalized_queries, если текст пришлось привести к нижнему регистру
+    normalized_queries.assign(query_count, std::string{});
+    std::vector<Query> queries(query_count);
+    std::vector<std::exception_ptr> errors(query_count);
+    ForEachIndex(std::execution::par, query_count, [&](size_t i) {
+        try {
+            queries[i] = ParseQuery(NormalizeText(raw_queries[i], normalized_queries[i]), std::execution::seq);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+    RethrowFirstError(errors);
+    return queries;
+}
+
+std::vector<size_t> SearchServer::RunBatch(const std::vector<const Query*>& queries, const QueryOptions& options,
+                                           const BatchResultWriter& write_result) const {
+    const size_t query_count = queries.size();
+    //тот же ключ, что у FindTopDocuments(query, options), поэтому пакет и одиночные запросы делят кеш результатов
+    std::vector<std::string> keys(query_count);
+    const std::string filter_key = DocumentFilter::Status({DocumentStatus::ACTUAL}).ToString();
+    ForEachIndex(std::execution::par, query_count, [&](size_t i) {
+        keys[i] = MakeResultCacheKey(*queries[i], filter_key, options, false);
+    });
+
+    //одинаковые после разбора запросы выполняем один раз
+    std::unordered_map<std::string_view, size_t> key_to_distinct;
+    std::vector<size_t> query_to_distinct(query_count);
+    std::vector<const Query*> distinct_queries;
+    std::vector<size_t> distinct_to_query;
+    for (size_t i = 0; i < query_count; ++i) {
+        const auto [it, inserted] = key_to_distinct.emplace(keys[i], distinct_queries.size());
+        if (inserted) {
+            distinct_queries.push_back(queries[i]);
+            distinct_to_query.push_back(i);
+        }
+        query_to_distinct[i] = it->second;
+    }
+
+    const ResolvedTerms terms = options.impact_ordered ? ResolvedTerms{} : ResolveTerms(distinct_queries);
+    const DocumentBitmap& actual_documents = GetStatusDocuments(DocumentStatus::ACTUAL);
+    QueryResultCache* const cache = result_cache_.Get();
+    //срок и отмена общие для пакета, но прерывание каждого запроса отслеживается отдельно
+    std::vector<QueryStatus> distinct_statuses(distinct_queries.size(), QueryStatus::COMPLETE);
+    std::vector<std::exception_ptr> errors(distinct_queries.size());
+    ForEachIndex(std::execution::par, distinct_queries.size(), [&](size_t d) {
+        TRACE_SCOPE("BatchQuery");
+        try {
+            const std::string& key = keys[distinct_to_query[d]];
+            if (cache != nullptr) {
+                if (auto cached_documents = cache->Find(key, index_generation_)) {
+                    write_result(d, distinct_to_query[d], std::move(*cached_documents));
+                    return;
+                }
+            }
+            QueryInterruption interruption(options);
+            std::vector<Document> documents;
+            if (options.impact_ordered) {
+                documents = FindTopDocumentsByImpact(*distinct_queries[d], [&actual_documents](int document_id) {
+                    return actual_documents.Contains(document_id);
+                }, options, interruption);
+            } else {
+                documents = FindAllDocuments(std::execution::seq, *distinct_queries[d],
+                                             [&actual_documents](int document_id) {
+                    return actual_documents.Contains(document_id);
+                }, interruption, nullptr, &terms);
+                KeepTopDocuments(documents, options.limit);
+            }
+            distinct_statuses[d] = interruption.GetStatus();
+            if (cache != nullptr && distinct_statuses[d] == QueryStatus::COMPLETE) {
+                cache->Insert(key, index_generation_, documents);
+            }
+            write_result(d, distinct_to_query[d], std::move(documents));
+        } catch (...) {
+            errors[d] = std::current_exception();
+        }
+    });
+    RethrowFirstError(errors);
+
+    //итог пакета - первый прерванный запрос
+    QueryStatus status = QueryStatus::COMPLETE;
+    for (const QueryStatus distinct_status : distinct_statuses) {
+        if (distinct_status != QueryStatus::COMPLETE) {
+            status = distinct_status;
+            break;
+        }
+    }
+    if (options.status != nullptr) {
+        *options.status = status;
+    }
+    if (status != QueryStatus::COMPLETE && !options.allow_partial) {
+        throw QueryInterruptedError(status);
+    }
+
+    return query_to_distinct;
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
-    return SearchServer::FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
+QueryExplanation SearchServer::ExplainQuery(std::string_view raw_query, const QueryOptions& options) const {
+    return ExplainQuery(raw_query, DocumentStatus::ACTUAL, options);
+}
+
+QueryExplanation SearchServer::ExplainQuery(std::string_view raw_query, DocumentStatus status,
+                                            const QueryOptions& options) const {
+    QueryExplanation explanation;
+    //стадии замеряются те же, что у FindTopDocuments, но попадают в объяснение, а не в статистику процесса
+    const StageTimings::CaptureScope capture(explanation.stage_durations);
+
+    std::string normalized_query;
+    const Query query = ParseQuery(NormalizeText(raw_query, normalized_query), std::execution::seq);
+
+    struct PlusTerm {
+        std::string_view word;
+        const std::map<int, double>* document_freqs;
+        double inverse_document_freq;
+    };
+    std::vector<PlusTerm> plus_terms;
+    for (std::string_view word : query.plus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        const size_t posting_count = it == word_to_document_freqs_.end() ? 0 : it->second.size();
+        const double inverse_document_freq = posting_count == 0 ? 0.0 : ComputeWordInverseDocumentFreq(word);
+        explanation.terms.push_back({std::string(word), false, inverse_document_freq, posting_count});
+        if (posting_count != 0) {
+            plus_terms.push_back({word, &it->second, inverse_document_freq});
+        }
+    }
+    for (std::string_view word : query.minus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        explanation.terms.push_back({std::string(word), true, 0.0,
+                                     it == word_to_document_freqs_.end() ? 0 : it->second.size()});
+    }
+
+    if (const QueryResultCache* cache = result_cache_.Get()) {
+        const std::string cache_key = MakeResultCacheKey(query, DocumentFilter::Status({status}).ToString(), options,
+                                                         false);
+        explanation.result_cached = cache->Contains(cache_key, index_generation_);
+    }
+
+    //тот же путь вычисления, что у последовательного FindTopDocuments, только мимо кеша результатов
+    const DocumentBitmap& status_documents = GetStatusDocuments(status);
+    const auto accept = [&status_documents](int document_id) {
+        return status_documents.Contains(document_id);
+    };
+    QueryInterruption interruption(options);
+    std::vector<Document> matched_documents;
+    if (options.impact_ordered) {
+        matched_documents = FindTopDocumentsByImpact(query, accept, options, interruption, &explanation.work);
+    } else {
+        matched_documents = FindAllDocuments(std::execution::seq, query, accept, interruption, &explanation.work);
+        KeepTopDocuments(matched_documents, options.limit);
+    }
+    interruption.Finish();
+
+    for (const Document& document : matched_documents) {
+        QueryExplanation::DocumentScore score{document, {}};
+        for (const PlusTerm& term : plus_terms) {
+            const auto it = term.document_freqs->find(document.id);
+            if (it != term.document_freqs->end()) {
+                score.contributions.push_back({std::string(term.word), it->second,
+                                               it->second * term.inverse_document_freq});
+            }
+        }
+        explanation.top_documents.push_back(std::move(score));
+    }
+    return explanation;
+}
+
+size_t SearchServer::EstimateQueryCost(std::string_view raw_query) const {
+    std::string normalized_query;
+    return ComputeQueryCost(ParseQuery(NormalizeText(raw_query, normalized_query), std::execution::seq));
+}
+
+SearchServer::PreparedQuery SearchServer::PrepareQuery(std::string_view raw_query) const {
+    auto state = std::make_unique<PreparedQuery::State>();
+    state->raw_query = std::string(raw_query);
+    state->query = ParseQuery(NormalizeText(state->raw_query, state->normalized_query), std::execution::seq);
+    state->cost = ComputeQueryCost(state->query);
+    return PreparedQuery(std::move(state));
+}
+
+void SearchServer::EnableThreadPool(size_t worker_count, bool pin_threads) {
+    thread_pool_ = std::make_shared<ThreadPool>(worker_count, pin_threads);
+}
+
+void SearchServer::DisableThreadPool() {
+    thread_pool_.reset();
+}
+
+ThreadPool* SearchServer::GetThreadPool() const {
+    return thread_pool_.get();
+}
+
+void SearchServer::EnableAsyncQueries(size_t worker_count, size_t queue_capacity) {
+    async_executor_.Enable(worker_count, queue_capacity);
+}
+
+void SearchServer::DisableAsyncQueries() {
+    async_executor_.Disable();
+}
+
+std::future<std::vector<Document>> SearchServer::SubmitFindTopDocuments(std::string raw_query,
+                                                                        const QueryOptions& options) const {
+    return SubmitFindTopDocuments(std::move(raw_query), DocumentStatus::ACTUAL, options);
+}
+
+std::future<std::vector<Document>> SearchServer::SubmitFindTopDocuments(std::string raw_query, DocumentStatus status,
+                                                                        const QueryOptions& options) const {
+    //текст запроса принадлежит задаче: вызывающий может освободить свой сразу после постановки
+    return GetAsyncExecutor().Submit([this, raw_query = std::move(raw_query), status, options] {
+        return FindTopDocuments(raw_query, status, options);
+    });
+}
+
+std::optional<std::future<std::vector<Document>>> SearchServer::TrySubmitFindTopDocuments(
+        std::string raw_query, const QueryOptions& options) const {
+    return TrySubmitFindTopDocuments(std::move(raw_query), DocumentStatus::ACTUAL, options);
+}
+
+std::optional<std::future<std::vector<Document>>> SearchServer::TrySubmitFindTopDocuments(
+        std::string raw_query, DocumentStatus status, const QueryOptions& options) const {
+    return GetAsyncExecutor().TrySubmit([this, raw_query = std::move(raw_query), status, options] {
+        return FindTopDocuments(raw_query, status, options);
+    });
+}
+
+std::future<DocStatusType> SearchServer::SubmitMatchDocument(std::string raw_query, int document_id) const {
+    return GetAsyncExecutor().Submit([this, raw_query = std::move(raw_query), document_id] {
+        return MatchDocument(raw_query, document_id);
+    });
+}
+
+#if defined(SEARCH_SERVER_HAS_COROUTINES)
+AsyncCall<std::vector<Document>> SearchServer::AwaitFindTopDocuments(std::string raw_query,
+                                                                     const QueryOptions& options) const {
+    return {GetAsyncExecutor(), [this, raw_query = std::move(raw_query), options] {
+        return FindTopDocuments(raw_query, options);
+    }};
+}
+#endif
+
+AsyncExecutor& SearchServer::GetAsyncExecutor() const {
+    AsyncExecutor* const executor = async_executor_.Get();
+    if (executor == nullptr) {
+        throw std::logic_error("Асинхронные запросы не включены: вызовите EnableAsyncQueries"s);
+    }
+    return *executor;
 }
 
 int SearchServer::GetDocumentCount() const {
     return documents_.size();
 }
 
+void SearchServer::SetCharClassTable(const Tokenizer::CharClassTable& table) {
+    if (!documents_.empty()) {
+        throw std::logic_error("Таблицу классов символов нельзя менять после добавления документов"s);
+    }
+    tokenizer_ = Tokenizer(table);
+}
+
+void SearchServer::SetCaseFolding(bool enabled) {
+    if (!documents_.empty()) {
+        throw std::logic_error("Приведение к нижнему регистру нельзя менять после добавления документов"s);
+    }
+    fold_case_ = enabled;
+    //стоп-слова строятся заново из заданных в конструкторе: после выключения они снова сравниваются с учетом регистра
+    if (!fold_case_) {
+        stop_words_ = configured_stop_words_;
+        return;
+    }
+    //стоп-слова сравниваются со словами в нижнем регистре
+    std::set<std::string_view> folded_stop_words;
+    std::string storage;
+    for (std::string_view word : configured_stop_words_) {
+        auto [it_word, _] = dictionary_.emplace(FoldCase(word, storage));
+        folded_stop_words.insert(*it_word);
+    }
+    stop_words_ = std::move(folded_stop_words);
+}
+
+void SearchServer::EnableResultCache(size_t capacity, size_t shard_count) {
+    result_cache_.Enable(capacity, shard_count);
+}
+
+void SearchServer::DisableResultCache() {
+    result_cache_.Disable();
+}
+
+const QueryResultCache* SearchServer::GetResultCache() const {
+    return result_cache_.Get();
+}
+
+void SearchServer::EnablePairPostingCache(size_t memory_budget, uint32_t admission_threshold) {
+    pair_posting_cache_.Enable(memory_budget, admission_threshold);
+}
+
+void SearchServer::DisablePairPostingCache() {
+    pair_posting_cache_.Disable();
+}
+
+const PairPostingCache* SearchServer::GetPairPostingCache() const {
+    return pair_posting_cache_.Get();
+}
+
 /* Реализуйте метод MatchDocument:
  * В первом элементе кортежа верните все плюс-слова запроса, содержащиеся в документе.
  * Слова не должны дублироваться. Пусть они будут отсортированы по возрастанию.
@@ -57,8 +541,10 @@ DocStatusType SearchServer::MatchDocument(std::string_view raw_query,
 DocStatusType SearchServer::MatchDocument(const std::execution::sequenced_policy&,
                                           std::string_view raw_query,
                                           int document_id) const {
+    ALLOCATION_SCOPE(AllocatingOperation::MATCH_DOCUMENT);
     //разберем запрос на структуру плюс и минус слов
-    const Query query = SearchServer::ParseQuery(raw_query, std::execution::seq);
+    std::string normalized_query;
+    const Query query = SearchServer::ParseQuery(NormalizeText(raw_query, normalized_query), std::execution::seq);
     std::vector<std::string_view> matched_words;
     //если документ содержит минус слово, то документ нам не подходит
     for (std::string_view word : query.minus_words) {
@@ -68,11 +554,12 @@ DocStatusType SearchServer::MatchDocument(const std::execution::sequenced_policy
         }
     }
     //для каждого плюс слова найдем документ, который его содержит
-    //и запомним плюс слово в таком случае
+    //и запомним плюс слово в таком случае; возвращаем слово из словаря сервера,
+    //а не из текста запроса, который может не пережить вызов
     for (std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) != 0 &&
-            word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end() && it->second.count(document_id)) {
+            matched_words.push_back(it->first);
         }
     }
     return {matched_words, documents_.at(document_id).status};
@@ -103,6 +590,104 @@ const std::map<std::string_view, double> &SearchServer::GetWordFrequencies(int d
     return empty_map;
 }
 
+IndexStatistics SearchServer::GetIndexStatistics(size_t top_count) const {
+    IndexStatistics statistics;
+    statistics.document_count = documents_.size();
+    //после удаления документов в индексе остаются слова с пустыми постингами, они не учитываются
+    std::vector<std::pair<std::string_view, size_t>> postings;
+    postings.reserve(word_to_document_freqs_.size());
+    for (const auto& [word, document_freqs] : word_to_document_freqs_) {
+        if (document_freqs.empty()) {
+            continue;
+        }
+        postings.emplace_back(word, document_freqs.size());
+        statistics.total_postings += document_freqs.size();
+        size_t bucket = 0;
+        while ((document_freqs.size() >> (bucket + 1)) != 0) {
+            ++bucket;
+        }
+        if (statistics.posting_length_histogram.size() <= bucket) {
+            statistics.posting_length_histogram.resize(bucket + 1);
+        }
+        ++statistics.posting_length_histogram[bucket];
+    }
+    statistics.vocabulary_size = postings.size();
+    statistics.index_memory_bytes = GetIndexMemoryUsage();
+    if (statistics.document_count > 0) {
+        statistics.average_unique_terms_per_document =
+                static_cast<double>(statistics.total_postings) / static_cast<double>(statistics.document_count);
+    }
+
+    const auto longer = [](const auto& lhs, const auto& rhs) {
+        return lhs.second > rhs.second || (lhs.second == rhs.second && lhs.first < rhs.first);
+    };
+    std::sort(postings.begin(), postings.end(), longer);
+    if (!postings.empty()) {
+        //постинги отсортированы по убыванию длины: перцентиль q находится на позиции (1 - q) * (n - 1)
+        const auto percentile = [&postings](double quantile) {
+            const auto index = static_cast<size_t>(std::round((1.0 - quantile) * static_cast<double>(postings.size() - 1)));
+            return postings[index].second;
+        };
+        IndexStatistics::PostingLengths& lengths = statistics.posting_lengths;
+        lengths.min = postings.back().second;
+        lengths.p50 = percentile(0.5);
+        lengths.p90 = percentile(0.9);
+        lengths.p99 = percentile(0.99);
+        lengths.max = postings.front().second;
+        lengths.mean = static_cast<double>(statistics.total_postings) / static_cast<double>(postings.size());
+    }
+    for (size_t i = 0; i < std::min(top_count, postings.size()); ++i) {
+        statistics.longest_postings.emplace_back(std::string(postings[i].first), postings[i].second);
+    }
+
+    for (const auto& [status, documents] : status_to_documents_) {
+        statistics.status_document_counts[static_cast<size_t>(status)] = documents.Size();
+    }
+
+    statistics.ingested_words = ingest_counters_.words;
+    for (const auto& [word, hits] : stop_word_hits_) {
+        statistics.stop_word_hits += hits;
+        statistics.stop_word_counts.emplace_back(std::string(word), hits);
+    }
+    std::sort(statistics.stop_word_counts.begin(), statistics.stop_word_counts.end(), longer);
+    if (statistics.ingested_words > 0) {
+        statistics.stop_word_hit_rate =
+                static_cast<double>(statistics.stop_word_hits) / static_cast<double>(statistics.ingested_words);
+    }
+    return statistics;
+}
+
+IngestCounters SearchServer::GetIngestCounters() const {
+    return ingest_counters_;
+}
+
+size_t SearchServer::GetIndexMemoryUsage() const {
+    //узел std::map и std::set: цвет и три указателя перед значением
+    constexpr size_t NODE_OVERHEAD = 4 * sizeof(void*);
+    constexpr size_t SSO_CAPACITY = 15;
+    size_t bytes = 0;
+    for (const std::string& word : dictionary_) {
+        bytes += NODE_OVERHEAD + sizeof(std::string) + (word.capacity() > SSO_CAPACITY ? word.capacity() + 1 : 0);
+    }
+    for (const auto& [word, document_freqs] : word_to_document_freqs_) {
+        bytes += NODE_OVERHEAD + sizeof(std::pair<const std::string_view, std::map<int, double>>)
+                 + document_freqs.size() * (NODE_OVERHEAD + sizeof(std::pair<const int, double>));
+    }
+    for (const auto& [document_id, word_freqs] : document_to_word_freqs_) {
+        bytes += NODE_OVERHEAD + sizeof(std::pair<const int, std::map<std::string_view, double>>)
+                 + word_freqs.size() * (NODE_OVERHEAD + sizeof(std::pair<const std::string_view, double>));
+    }
+    bytes += documents_.size() * (NODE_OVERHEAD + sizeof(std::pair<const int, DocumentData>));
+    bytes += document_ids_.size() * (NODE_OVERHEAD + sizeof(int));
+    for (const auto& [status, documents] : status_to_documents_) {
+        bytes += NODE_OVERHEAD + sizeof(std::pair<const DocumentStatus, DocumentBitmap>) + documents.GetMemoryUsage();
+    }
+    for (const auto& [rating, documents] : rating_to_documents_) {
+        bytes += NODE_OVERHEAD + sizeof(std::pair<const int, DocumentBitmap>) + documents.GetMemoryUsage();
+    }
+    return bytes;
+}
+
 /**
  * Delete doc by doc_id
  * @param document_id - id of doc to delete
@@ -114,25 +699,38 @@ void SearchServer::RemoveDocument(int document_id) {
 //private:
 
 bool SearchServer::IsStopWord(std::string_view word) const {
-    return stop_words_.count(std::string{word}) > 0;
+    return stop_words_.count(word) > 0;
+}
+
+std::string_view SearchServer::NormalizeText(std::string_view text, std::string& storage) const {
+    return fold_case_ ? FoldCase(text, storage) : text;
 }
 
-bool SearchServer::IsValidWord(std::string_view word) {
+size_t SearchServer::FindInvalidCharacter(std::string_view word) {
     // A valid word must not contain special characters
-    return std::none_of(word.begin(), word.end(), [](char c) {
+    const auto it = std::find_if(word.begin(), word.end(), [](char c) {
         return c >= '\0' && c < ' ';
     });
+    return it == word.end() ? std::string_view::npos : static_cast<size_t>(it - word.begin());
 }
 
-const std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text) const {
+std::string SearchServer::DescribeInvalidCharacter(char c, std::string_view place) {
+    return "Недопустимый символ с кодом "s + std::to_string(static_cast<unsigned char>(c)) + ' ' + std::string(place);
+}
+
+const std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text,
+                                                                       std::vector<std::string_view>& stop_words) const {
     std::vector<std::string_view> words;
-    for (std::string_view word : SplitIntoWordsView(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("Недопустимые символы (с кодами от 0 до 31) в тексте добавляемого документа"s);
-        }
+    const bool is_valid = tokenizer_.ForEachWord(text, [this, &words, &stop_words](std::string_view word) {
         if (!IsStopWord(word)) {
             words.push_back(word);
+        } else {
+            stop_words.push_back(word);
         }
+    });
+    if (!is_valid) {
+        throw std::invalid_argument(
+                DescribeInvalidCharacter(text[tokenizer_.FindInvalid(text)], "в тексте добавляемого документа"));
     }
     return words;
 }
@@ -156,24 +754,244 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
         is_minus = true;
         text = text.substr(1);
     }
-    if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
+    //недопустимые символы уже отсеяны при делении запроса на слова
+    if (text.empty() || text[0] == '-') {
         throw std::invalid_argument("ParseQueryWord: Текст запроса некорректен"s);
     }
 
     return SearchServer::QueryWord{text, is_minus, IsStopWord(text)};
 }
 
+const DocumentBitmap& SearchServer::GetStatusDocuments(DocumentStatus status) const {
+    static const DocumentBitmap empty_bitmap;
+    const auto it = status_to_documents_.find(status);
+    if (it != status_to_documents_.end()) {
+        return it->second;
+    }
+    return empty_bitmap;
+}
+
+const SearchServer::Query& SearchServer::GetParsedQuery(std::string_view raw_query, std::string& normalized_query,
+                                                      Query& parsed_query) const {
+    parsed_query = ParseQuery(NormalizeText(raw_query, normalized_query), std::execution::seq);
+    return parsed_query;
+}
+
+const SearchServer::Query& SearchServer::GetParsedQuery(const PreparedQuery& query, std::string&, Query&) const {
+    return query.state_->query;
+}
+
+size_t SearchServer::ComputeQueryCost(const Query& query) const {
+    size_t cost = 0;
+    const auto add_postings = [this, &cost](std::string_view word) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end()) {
+            cost += it->second.size();
+        }
+    };
+    for (std::string_view word : query.plus_words) {
+        add_postings(word);
+    }
+    for (std::string_view word : query.minus_words) {
+        add_postings(word);
+    }
+    return cost;
+}
+
+DocumentBitmap SearchServer::CollectExcludedDocuments(const Query& query, const ResolvedTerms* terms) const {
+    STAGE_TIMER(QueryStage::MINUS_FILTER);
+    DocumentBitmap excluded_documents;
+    for (std::string_view word : query.minus_words) {
+        const std::map<int, double>* document_freqs = nullptr;
+        if (terms != nullptr) {
+            document_freqs = terms->at(word).document_freqs;
+        } else if (const auto it = word_to_document_freqs_.find(word); it != word_to_document_freqs_.end()) {
+            document_freqs = &it->second;
+        }
+        if (document_freqs == nullptr) {
+            continue;
+        }
+        for (const auto& [document_id, _] : *document_freqs) {
+            excluded_documents.Add(document_id);
+        }
+    }
+    return excluded_documents;
+}
+
+std::string SearchServer::MakeResultCacheKey(const Query& query, const std::string& filter_key,
+                                             const QueryOptions& options, bool is_parallel) {
+    //слова запроса уже отсортированы и без повторов, поэтому одинаковые запросы дают одинаковый ключ
+    std::string key;
+    for (std::string_view word : query.plus_words) {
+        key += '+';
+        key += word;
+        key += ' ';
+    }
+    for (std::string_view word : query.minus_words) {
+        key += '-';
+        key += word;
+        key += ' ';
+    }
+    key += '|';
+    key += filter_key;
+    key += "|limit="s + std::to_string(options.limit);
+    if (options.impact_ordered) {
+        key += "|impact="s + std::to_string(options.postings_budget);
+    }
+    key += is_parallel ? "|par"s : "|seq"s;
+    return key;
+}
+
+void SearchServer::KeepTopDocuments(std::vector<Document>& documents, int limit) {
+    STAGE_TIMER(QueryStage::SELECT);
+    const auto count = static_cast<size_t>(std::max(limit, 0));
+    if (documents.size() > count) {
+        std::partial_sort(documents.begin(), documents.begin() + count, documents.end(), IsMoreRelevant);
+        documents.resize(count);
+    } else {
+        std::sort(documents.begin(), documents.end(), IsMoreRelevant);
+    }
+}
+
+bool SearchServer::IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
 double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const {
     return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
 }
 
+SearchServer::ResolvedTerms SearchServer::ResolveTerms(const std::vector<const Query*>& queries) const {
+    STAGE_TIMER(QueryStage::LOOKUP);
+    ResolvedTerms terms;
+    std::unordered_map<std::string_view, size_t> plus_word_usage;
+    const auto resolve = [this, &terms](std::string_view word) {
+        const auto [it_term, inserted] = terms.try_emplace(word);
+        if (!inserted) {
+            return;
+        }
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end() && !it->second.empty()) {
+            it_term->second.document_freqs = &it->second;
+            it_term->second.inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+        }
+    };
+    for (const Query* query : queries) {
+        for (std::string_view word : query->plus_words) {
+            resolve(word);
+            ++plus_word_usage[word];
+        }
+        for (std::string_view word : query->minus_words) {
+            resolve(word);
+        }
+    }
+
+    //постинги плюс-слова, общего для нескольких запросов, обходим один раз, а запросы читают готовые вклады
+    std::vector<ResolvedTerm*> shared_terms;
+    for (const auto& [word, usage] : plus_word_usage) {
+        ResolvedTerm& term = terms.at(word);
+        if (usage > 1 && term.document_freqs != nullptr) {
+            shared_terms.push_back(&term);
+        }
+    }
+    ForEachIndex(std::execution::par, shared_terms.size(), [&shared_terms](size_t i) {
+        ResolvedTerm* term = shared_terms[i];
+        term->contributions.reserve(term->document_freqs->size());
+        for (const auto& [document_id, term_freq] : *term->document_freqs) {
+            term->contributions.emplace_back(document_id, term_freq * term->inverse_document_freq);
+        }
+    });
+    return terms;
+}
+
+std::vector<SearchServer::ScoringUnit> SearchServer::PlanScoringUnits(const Query& query,
+                                                                      const ResolvedTerms* terms) const {
+    STAGE_TIMER(QueryStage::LOOKUP);
+    //слова, которых нет в корпусе, не считаем и в пары не берем
+    std::vector<ScoringUnit> words;
+    for (std::string_view word : query.plus_words) {
+        if (terms != nullptr) {
+            const ResolvedTerm& term = terms->at(word);
+            if (term.document_freqs != nullptr) {
+                words.push_back({word, nullptr, term.document_freqs, term.inverse_document_freq,
+                                 term.contributions.empty() ? nullptr : &term.contributions});
+            }
+            continue;
+        }
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end() && !it->second.empty()) {
+            words.push_back({word, nullptr, &it->second, ComputeWordInverseDocumentFreq(word), nullptr});
+        }
+    }
+    PairPostingCache* const cache = pair_posting_cache_.Get();
+    if (cache == nullptr || words.size() < 2 || words.size() > MAX_PAIRED_PLUS_WORDS) {
+        return words;
+    }
+    //каждое слово входит не больше чем в одну пару: пары с уже занятым словом не запрашиваются из кеша,
+    //иначе кеш строил бы и хранил постинги, которые этот запрос все равно не использует
+    std::vector<ScoringUnit> units;
+    std::vector<bool> paired(words.size(), false);
+    for (size_t i = 0; i < words.size(); ++i) {
+        for (size_t j = i + 1; j < words.size() && !paired[i]; ++j) {
+            if (paired[j]) {
+                continue;
+            }
+            auto postings = cache->Acquire(words[i].word, words[j].word, index_generation_, [this, &words, i, j] {
+                return MergePairPostings(words[i].word, words[j].word);
+            });
+            if (postings) {
+                paired[i] = paired[j] = true;
+                units.push_back({{}, std::move(postings), nullptr, 0.0, nullptr});
+            }
+        }
+    }
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (!paired[i]) {
+            units.push_back(words[i]);
+        }
+    }
+    return units;
+}
+
+PairPostingCache::Postings SearchServer::MergePairPostings(std::string_view first, std::string_view second) const {
+    const std::map<int, double>& first_freqs = word_to_document_freqs_.at(first);
+    const std::map<int, double>& second_freqs = word_to_document_freqs_.at(second);
+    const double first_idf = ComputeWordInverseDocumentFreq(first);
+    const double second_idf = ComputeWordInverseDocumentFreq(second);
+
+    PairPostingCache::Postings postings;
+    postings.reserve(first_freqs.size() + second_freqs.size());
+    auto it_first = first_freqs.begin();
+    auto it_second = second_freqs.begin();
+    while (it_first != first_freqs.end() || it_second != second_freqs.end()) {
+        if (it_second == second_freqs.end() || (it_first != first_freqs.end() && it_first->first < it_second->first)) {
+            postings.emplace_back(it_first->first, it_first->second * first_idf);
+            ++it_first;
+        } else if (it_first == first_freqs.end() || it_second->first < it_first->first) {
+            postings.emplace_back(it_second->first, it_second->second * second_idf);
+            ++it_second;
+        } else {
+            postings.emplace_back(it_first->first, it_first->second * first_idf + it_second->second * second_idf);
+            ++it_first;
+            ++it_second;
+        }
+    }
+    postings.shrink_to_fit();
+    return postings;
+}
+
 /* Параллельные алгоритмы. Урок 9: Параллелим методы поисковой системы 2/3
 * Реализуйте многопоточную версию метода MatchDocument в дополнение к однопоточной.
 */
 [[maybe_unused]] DocStatusType SearchServer::MatchDocument(const std::execution::parallel_policy&,
                                                            std::string_view raw_query,
                                                            int document_id) const {
-    const Query query = ParseQuery(raw_query, std::execution::par);
+    ALLOCATION_SCOPE(AllocatingOperation::MATCH_DOCUMENT);
+    std::string normalized_query;
+    const Query query = ParseQuery(NormalizeText(raw_query, normalized_query), std::execution::par);
     std::vector<std::string_view> matched_words;
     //если хоть одно минус слово встречается в документе - возвращаем пустой матчинг
     if (any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(),
@@ -195,7 +1013,11 @@ double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const
                                        word_to_document_freqs_.at(word).count(document_id) > 0);
                            }
     );
-    //
+    //слова запроса заменяем словами из словаря сервера: текст запроса может не пережить вызов
+    std::transform(std::execution::par, matched_words.begin(), it, matched_words.begin(),
+                   [this](std::string_view word) {
+                       return word_to_document_freqs_.find(word)->first;
+                   });
     std::sort(std::execution::par, matched_words.begin(), it);
     it = std::unique(std::execution::par, matched_words.begin(), it);
     matched_words.erase(it, matched_words.end());
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <stdexcept>
+#include <exception>
 #include <map>
 #include <set>
 #include <tuple>
@@ -10,19 +11,77 @@
 #include <algorithm>
 #include <cmath>
 #include <execution>
+#include <unordered_map>
+#include <mutex>
+#include <functional>
+#include <optional>
 
 #include "document.h"
 #include "string_processing.h"
 #include "log_duration.h"
 #include "concurrent_map.h"
+#include "query_options.h"
+#include "query_interruption.h"
+#include "impact_index.h"
+#include "document_bitmap.h"
+#include "document_filter.h"
+#include "query_cache.h"
+#include "pair_posting_cache.h"
+#include "cache_holder.h"
+#include "small_vector.h"
+#include "tokenizer.h"
+#include "case_folding.h"
+#include "query_batch_results.h"
+#include "thread_pool.h"
+#include "async_executor.h"
+#include "stage_timings.h"
+#include "trace.h"
+#include "allocation_counter.h"
+#include "query_explanation.h"
+#include "index_statistics.h"
 
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double EPSILON = 1e-6;
 
 using DocStatusType = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 
+//документ для пакетного добавления через SearchServer::AddDocuments
+struct NewDocument {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+//добавлено в сервер с момента создания; удаление документов счетчики не уменьшает
+struct IngestCounters {
+    uint64_t documents = 0;
+    uint64_t words = 0;  // включая стоп-слова
+};
+
 class SearchServer {
 public:
+    /* Запрос, разобранный заранее (PrepareQuery): его стоимость известна до выполнения,
+     * а FindTopDocuments и FindTopDocumentsBatch не разбирают его текст заново. Хранит копию текста
+     * и действителен, пока у создавшего его сервера не менялись стоп-слова и настройки разбора
+     */
+    class PreparedQuery {
+    public:
+        PreparedQuery(PreparedQuery&&) noexcept;
+        PreparedQuery& operator=(PreparedQuery&&) noexcept;
+        ~PreparedQuery();
+
+        // то же, что EstimateQueryCost для текста запроса
+        [[nodiscard]] size_t GetCost() const;
+
+    private:
+        friend class SearchServer;
+        struct State;
+
+        explicit PreparedQuery(std::unique_ptr<State> state);
+
+        std::unique_ptr<State> state_;
+    };
+
     SearchServer() = default;
     /*
      *  универсально создавать search-server, передавая в него при создании стоп-слова любыми
@@ -37,24 +96,156 @@ public:
     explicit SearchServer(std::string_view stop_words);
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    /* Пакетное добавление: тексты документов разбираются на слова параллельно, затем документы
+     * добавляются в индекс по очереди. Если хотя бы один документ некорректен, не добавляется ни один
+     */
+    void AddDocuments(const std::vector<NewDocument>& documents);
 
+    /* Во всех перегрузках последним аргументом можно передать QueryOptions,
+     * например число возвращаемых документов: FindTopDocuments(query, QueryOptions{50})
+     */
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           const QueryOptions& options = {}) const;
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                                         const QueryOptions& options = {}) const;
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                                         const QueryOptions& options = {}) const;
+    /* Структурированный фильтр проверяется по индексам сервера до начисления релевантности
+     * и обходится дешевле произвольного предиката
+     */
+    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter,
+                                                         const QueryOptions& options = {}) const;
+    // то же для подготовленного запроса
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
-    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
-    [[nodiscard]] std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+    std::vector<Document> FindTopDocuments(const PreparedQuery& query, DocumentPredicate document_predicate,
+                                           const QueryOptions& options = {}) const;
+    [[nodiscard]] std::vector<Document> FindTopDocuments(const PreparedQuery& query, DocumentStatus status,
+                                                         const QueryOptions& options = {}) const;
+    [[nodiscard]] std::vector<Document> FindTopDocuments(const PreparedQuery& query,
+                                                         const QueryOptions& options = {}) const;
 
     /* Спринт 8. Параллелим поиск документов
      *
      */
     template <typename ExecutionPolicy, typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const ExecutionPolicy& exec_policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& exec_policy, std::string_view raw_query,
+                                           DocumentPredicate document_predicate, const QueryOptions& options = {}) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& exec_policy, std::string_view raw_query,
+                                           DocumentStatus status, const QueryOptions& options = {}) const;
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(const ExecutionPolicy& exec_policy, std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& exec_policy, std::string_view raw_query,
+                                           const QueryOptions& options = {}) const;
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(const ExecutionPolicy& exec_policy, std::string_view raw_query) const;
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& exec_policy, std::string_view raw_query,
+                                           const DocumentFilter& filter, const QueryOptions& options = {}) const;
+
+    /* Пакетное выполнение запросов, аналогичное FindTopDocuments(query, options) для каждого запроса.
+     * Все запросы разбираются заранее, одинаковые выполняются один раз, а каждое слово пакета
+     * ищется в индексе и получает idf один раз; постинги слов, общих для нескольких запросов,
+     * один раз переводятся в непрерывный массив вкладов tf*idf. Запросы считаются тем же кодом,
+     * что FindTopDocuments, в том числе по кешу пар слов
+     */
+    [[nodiscard]] QueryBatchResults FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+                                                          const QueryOptions& options = {}) const;
+    [[nodiscard]] QueryBatchResults FindTopDocumentsBatch(const std::vector<PreparedQuery>& queries,
+                                                          const QueryOptions& options = {}) const;
+    /* То же, но результаты всех запросов лежат в одном массиве: рабочие потоки пишут результат
+     * сразу в отведенное запросу место размером min(limit, число документов ACTUAL), после чего
+     * результаты сдвигаются к началу
+     */
+    [[nodiscard]] JoinedDocuments FindTopDocumentsBatchJoined(const std::vector<std::string>& raw_queries,
+                                                              const QueryOptions& options = {}) const;
+
+    /* Выполняет запрос тем же путем, что последовательный FindTopDocuments(raw_query, status, options),
+     * и объясняет результат: слова запроса с idf и длиной списков документов, счетчики работы,
+     * вклад каждого слова в релевантность найденных документов и время стадий. Учитываются impact_ordered,
+     * postings_budget, срок, отмена и кеш пар; кеш результатов не читается и не пополняется, а только
+     * проверяется. Время стадий не попадает в StageTimings
+     */
+    [[nodiscard]] QueryExplanation ExplainQuery(std::string_view raw_query, DocumentStatus status,
+                                                const QueryOptions& options = {}) const;
+    [[nodiscard]] QueryExplanation ExplainQuery(std::string_view raw_query, const QueryOptions& options = {}) const;
+
+    /* Оценка стоимости запроса до его выполнения: суммарная длина списков документов
+     * его плюс- и минус-слов. Для некорректного запроса выбрасывает std::invalid_argument
+     */
+    [[nodiscard]] size_t EstimateQueryCost(std::string_view raw_query) const;
+    /* Разбирает запрос один раз: стоимость берется из него же, а поиск по нему не разбирает
+     * текст снова. Для некорректного запроса выбрасывает std::invalid_argument
+     */
+    [[nodiscard]] PreparedQuery PrepareQuery(std::string_view raw_query) const;
 
     [[nodiscard]] int GetDocumentCount() const;
 
+    /* Собственный пул потоков с перехватом работы. Если он задан, параллельные пути сервера
+     * (ProcessQueries, FindTopDocuments и RemoveDocument с std::execution::par, AddDocuments)
+     * выполняются в нем, а не через std::execution::par, и загрузка процессора ограничена числом его потоков.
+     * Копии сервера делят один пул
+     */
+    void EnableThreadPool(size_t worker_count, bool pin_threads = false);
+    void DisableThreadPool();
+    // nullptr, если пул не задан
+    [[nodiscard]] ThreadPool* GetThreadPool() const;
+
+    /* Асинхронные запросы, по умолчанию выключены. Запросы выполняются в worker_count потоках исполнителя;
+     * если в очереди уже queue_capacity запросов, Submit* ждет освобождения места, а TrySubmit*
+     * сразу возвращает пустой optional.
+     * Пока есть невыполненные запросы, сервер нельзя менять; выключение исполнителя и разрушение
+     * сервера дожидаются их выполнения. У копии сервера собственный исполнитель.
+     * Без EnableAsyncQueries методы Submit* выбрасывают std::logic_error
+     */
+    void EnableAsyncQueries(size_t worker_count, size_t queue_capacity = 1024);
+    void DisableAsyncQueries();
+    [[nodiscard]] std::future<std::vector<Document>> SubmitFindTopDocuments(std::string raw_query,
+                                                                          const QueryOptions& options = {}) const;
+    [[nodiscard]] std::future<std::vector<Document>> SubmitFindTopDocuments(std::string raw_query, DocumentStatus status,
+                                                                          const QueryOptions& options = {}) const;
+    [[nodiscard]] std::optional<std::future<std::vector<Document>>> TrySubmitFindTopDocuments(
+            std::string raw_query, const QueryOptions& options = {}) const;
+    [[nodiscard]] std::optional<std::future<std::vector<Document>>> TrySubmitFindTopDocuments(
+            std::string raw_query, DocumentStatus status, const QueryOptions& options = {}) const;
+    [[nodiscard]] std::future<DocStatusType> SubmitMatchDocument(std::string raw_query, int document_id) const;
+#if defined(SEARCH_SERVER_HAS_COROUTINES)
+    // для корутин C++20: auto documents = co_await server.AwaitFindTopDocuments(query);
+    [[nodiscard]] AsyncCall<std::vector<Document>> AwaitFindTopDocuments(std::string raw_query,
+                                                                         const QueryOptions& options = {}) const;
+#endif
+
+    /* Таблица классов символов, по которой документы и запросы делятся на слова.
+     * По умолчанию разделитель - пробел, а символы с кодами от 0 до 31 недопустимы.
+     * Менять таблицу можно только до добавления первого документа; стоп-слова, переданные
+     * в конструктор, по ней не перечитываются
+     */
+    void SetCharClassTable(const Tokenizer::CharClassTable& table);
+
+    /* Приведение документов, запросов и стоп-слов к нижнему регистру (UTF-8), по умолчанию выключено:
+     * "Кот" и "кот" становятся одним словом словаря. Складываются только буквы, у которых строчная форма
+     * занимает столько же байтов: латиница с расширениями, греческий, кириллица, армянский, грузинский и
+     * полноширинная латиница (см. FoldCase); остальные символы и все четырехбайтовые остаются как есть.
+     * Включать и выключать можно только до добавления первого документа
+     */
+    void SetCaseFolding(bool enabled);
+
+    /* Кеш результатов поиска, по умолчанию выключен. Запросы со статусом или DocumentFilter
+     * (а с ними RequestQueue и ProcessQueries) пользуются им прозрачно. Запросы с произвольным
+     * предикатом не кешируются: предикаты нельзя сравнить между собой.
+     */
+    void EnableResultCache(size_t capacity, size_t shard_count = 16);
+    void DisableResultCache();
+    // nullptr, если кеш выключен
+    [[nodiscard]] const QueryResultCache* GetResultCache() const;
+
+    /* Кеш постингов для частых пар плюс-слов, по умолчанию выключен. Пара, встретившаяся
+     * в admission_threshold запросах, кешируется с уже сложенным вкладом обоих слов,
+     * и FindAllDocuments обходит ее постинги вместо постингов двух слов
+     */
+    void EnablePairPostingCache(size_t memory_budget, uint32_t admission_threshold = 3);
+    void DisablePairPostingCache();
+    // nullptr, если кеш выключен
+    [[nodiscard]] const PairPostingCache* GetPairPostingCache() const;
+
     /* Реализуйте метод MatchDocument:
      * В первом элементе кортежа верните все плюс-слова запроса, содержащиеся в документе.
      * Слова не должны дублироваться. Пусть они будут отсортированы по возрастанию.
@@ -87,6 +278,17 @@ public:
      * Если документа не существует, возвратите ссылку на пустой map.
      */
     [[nodiscard]] const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+
+    /* Сводка по индексу: размер словаря, перцентили и гистограмма длин постингов, top_count самых
+     * длинных постингов, среднее число разных слов в документе, документы по статусам и доля стоп-слов.
+     * Обходит весь индекс, поэтому предназначена для диагностики, а не для вызова на каждый запрос
+     */
+    [[nodiscard]] IndexStatistics GetIndexStatistics(size_t top_count = 10) const;
+    [[nodiscard]] IngestCounters GetIngestCounters() const;
+    /* Примерный объем памяти индекса в байтах: строки словаря, узлы словарей частот и множеств документов,
+     * битовые карты статусов и рейтингов. Кеши не учитываются, у них своя статистика
+     */
+    [[nodiscard]] size_t GetIndexMemoryUsage() const;
     /* Спринт 5
      * Разработайте метод удаления документов из поискового сервера
      */
@@ -105,6 +307,8 @@ private:
     };
     std::set<std::string> dictionary_;
     std::set<std::string_view> stop_words_;
+    //стоп-слова в том виде, в каком заданы в конструкторе; stop_words_ - они же в нижнем регистре, если это включено
+    std::set<std::string_view> configured_stop_words_;
     std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
     /* Спринт 5.
      * Добавлено для хранения частоты слов по документам
@@ -116,12 +320,54 @@ private:
      * Vector refactor to set for ease erase
      */
     std::set<int> document_ids_;
+    //id документов по статусам, для фильтрации по статусу без обращения к documents_
+    std::map<DocumentStatus, DocumentBitmap> status_to_documents_;
+    //id документов по рейтингу: диапазон рейтинга превращается в набор корзин без обращения к documents_
+    std::map<int, DocumentBitmap> rating_to_documents_;
+    //меняется при каждом добавлении и удалении документа
+    uint64_t index_generation_ = 0;
+    //объединения корзин rating_to_documents_ для широких диапазонов рейтинга в фильтрах
+    RatingRangeCache rating_range_cache_;
+    //постинги, упорядоченные по вкладу; строятся лениво для запросов с QueryOptions::impact_ordered
+    LazyImpactIndex impact_index_;
+    CacheHolder<QueryResultCache> result_cache_;
+    CacheHolder<PairPostingCache> pair_posting_cache_;
+    Tokenizer tokenizer_;
+    bool fold_case_ = false;
+    //добавленные документы и слова, попадания по каждому стоп-слову - для GetIndexStatistics
+    IngestCounters ingest_counters_;
+    std::map<std::string_view, uint64_t> stop_word_hits_;
+    std::shared_ptr<ThreadPool> thread_pool_;
+    //последний член: разрушается первым и дожидается запросов, пока остальные члены еще живы
+    CacheHolder<AsyncExecutor> async_executor_;
 
     [[nodiscard]] bool IsStopWord(std::string_view word) const;
 
-    static bool IsValidWord(std::string_view word);
+    //текст в нижнем регистре, если это включено; storage используется, только если текст пришлось менять
+    [[nodiscard]] std::string_view NormalizeText(std::string_view text, std::string& storage) const;
+
+    //позиция первого символа стоп-слова с кодом от 0 до 31 либо npos
+    static size_t FindInvalidCharacter(std::string_view word);
+    // "Недопустимый символ с кодом N " + place
+    static std::string DescribeInvalidCharacter(char c, std::string_view place);
+
+    //встреченные стоп-слова дописываются в stop_words
+    [[nodiscard]] const std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text,
+                                                                           std::vector<std::string_view>& stop_words) const;
 
-    [[nodiscard]] const std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+    //добавляет в индекс документ, уже разобранный на слова
+    void InsertDocument(int document_id, const std::vector<std::string_view>& words,
+                        const std::vector<std::string_view>& stop_words, DocumentStatus status,
+                        const std::vector<int>& ratings);
+
+    //исполнитель асинхронных запросов; std::logic_error, если они не включены
+    [[nodiscard]] AsyncExecutor& GetAsyncExecutor() const;
+
+    //вызывает func(i) для i из [0, count): в пуле потоков сервера, если он задан и политика параллельная, иначе с политикой exec_policy
+    template <typename ExecutionPolicy, typename Func>
+    void ForEachIndex(const ExecutionPolicy& exec_policy, size_t count, Func func) const;
+    //ошибки задач ForEachIndex собираются в errors: исключение, выпущенное из параллельного алгоритма, завершает программу
+    static void RethrowFirstError(const std::vector<std::exception_ptr>& errors);
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
@@ -133,9 +379,13 @@ private:
 
     [[nodiscard]] QueryWord ParseQueryWord(std::string_view text) const;
 
+    //слова обычного запроса помещаются во встроенный буфер, и разбор запроса обходится без кучи
+    static constexpr size_t INLINE_QUERY_WORDS = 16;
+    using QueryWords = SmallVector<std::string_view, INLINE_QUERY_WORDS>;
+
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        QueryWords plus_words;
+        QueryWords minus_words;
     };
     /*
      * Разберем запрос на структуру пллюс слова и минус слова
@@ -145,9 +395,93 @@ private:
 
     [[nodiscard]] double ComputeWordInverseDocumentFreq(std::string_view word) const;
 
-    template <typename ExecutionPolicy, typename DocumentPredicate>
+    //пары перебираются только в коротких запросах, число пар растет квадратично
+    static constexpr size_t MAX_PAIRED_PLUS_WORDS = 8;
+
+    /* Слово пакета запросов, найденное в индексе. Пакет ищет слова и считает idf один раз,
+     * а запросы пакета получают их через параметр terms методов ниже
+     */
+    struct ResolvedTerm {
+        const std::map<int, double>* document_freqs = nullptr;
+        double inverse_document_freq = 0.0;
+        //вклады tf*idf по возрастанию id документа; строятся для плюс-слов нескольких запросов пакета
+        std::vector<std::pair<int, double>> contributions;
+    };
+    using ResolvedTerms = std::unordered_map<std::string_view, ResolvedTerm>;
+
+    [[nodiscard]] ResolvedTerms ResolveTerms(const std::vector<const Query*>& queries) const;
+
+    //получает результат различного запроса пакета и номер первого запроса пакета с таким текстом
+    using BatchResultWriter = std::function<void(size_t distinct, size_t first_query, std::vector<Document> documents)>;
+    /* Выполняет пакет: write_result вызывается из рабочих потоков один раз для каждого различного запроса.
+     * Возвращает для каждого запроса номер его различного запроса; номера идут в порядке первого появления
+     */
+    std::vector<size_t> RunBatch(const std::vector<const Query*>& queries, const QueryOptions& options,
+                                 const BatchResultWriter& write_result) const;
+    QueryBatchResults CollectBatchResults(const std::vector<const Query*>& queries, const QueryOptions& options) const;
+    //разбирает запросы пакета параллельно; разобранные запросы ссылаются на normalized_queries
+    [[nodiscard]] std::vector<Query> ParseBatch(const std::vector<std::string>& raw_queries,
+                                                std::vector<std::string>& normalized_queries) const;
+
+    //единица начисления релевантности: плюс-слово или закешированная пара плюс-слов
+    struct ScoringUnit {
+        std::string_view word;
+        std::shared_ptr<const PairPostingCache::Postings> pair_postings;
+        //постинги и idf одиночного слова; contributions - готовые вклады tf*idf, если их построил пакет
+        const std::map<int, double>* document_freqs = nullptr;
+        double inverse_document_freq = 0.0;
+        const std::vector<std::pair<int, double>>* contributions = nullptr;
+    };
+
+    /* Разбивает плюс-слова на закешированные пары и одиночные слова. Слова ищутся в terms,
+     * если они заданы, иначе в индексе
+     */
+    [[nodiscard]] std::vector<ScoringUnit> PlanScoringUnits(const Query& query,
+                                                            const ResolvedTerms* terms = nullptr) const;
+    [[nodiscard]] PairPostingCache::Postings MergePairPostings(std::string_view first, std::string_view second) const;
+
+
+    //документы, содержащие хотя бы одно минус-слово запроса
+    [[nodiscard]] DocumentBitmap CollectExcludedDocuments(const Query& query,
+                                                          const ResolvedTerms* terms = nullptr) const;
+
+    //пустое множество, если документов с таким статусом нет
+    [[nodiscard]] const DocumentBitmap& GetStatusDocuments(DocumentStatus status) const;
+
+    /* Внутренние методы поиска принимают вместо предиката document_acceptor(document_id) -> bool:
+     * фильтр по статусу проверяет его по битовой карте, не обращаясь к documents_.
+     * filter_key - запись фильтра для ключа кеша результатов; пустая, если результат кешировать нельзя
+     */
+    template <typename ExecutionPolicy, typename QueryText, typename DocumentAcceptor>
+    std::vector<Document> FindTopDocumentsImpl(const ExecutionPolicy& exec_policy, const QueryText& query_text,
+                                               DocumentAcceptor document_acceptor, const std::string& filter_key,
+                                               const QueryOptions& options) const;
+    //разбирает текст запроса в parsed_query; подготовленный запрос уже разобран
+    const Query& GetParsedQuery(std::string_view raw_query, std::string& normalized_query, Query& parsed_query) const;
+    const Query& GetParsedQuery(const PreparedQuery& query, std::string& normalized_query, Query& parsed_query) const;
+    //суммарная длина списков документов плюс- и минус-слов
+    [[nodiscard]] size_t ComputeQueryCost(const Query& query) const;
+
+    static std::string MakeResultCacheKey(const Query& query, const std::string& filter_key,
+                                          const QueryOptions& options, bool is_parallel);
+
+    /* work, если не nullptr, получает счетчики проделанной работы для ExplainQuery;
+     * terms - слова, уже найденные пакетом запросов
+     */
+    template <typename ExecutionPolicy, typename DocumentAcceptor>
     std::vector<Document> FindAllDocuments(const ExecutionPolicy& exec_policy, const Query& query,
-                                           DocumentPredicate document_predicate) const;
+                                           DocumentAcceptor document_acceptor, QueryInterruption& interruption,
+                                           QueryExplanation::WorkCounters* work = nullptr,
+                                           const ResolvedTerms* terms = nullptr) const;
+
+    template <typename DocumentAcceptor>
+    std::vector<Document> FindTopDocumentsByImpact(const Query& query, DocumentAcceptor document_acceptor,
+                                                   const QueryOptions& options, QueryInterruption& interruption,
+                                                   QueryExplanation::WorkCounters* work = nullptr) const;
+
+    static bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+    //оставляет limit самых релевантных документов, упорядоченных по релевантности
+    static void KeepTopDocuments(std::vector<Document>& documents, int limit);
 };
 
 /*
@@ -157,10 +491,10 @@ private:
 template <typename StringContainer>
  SearchServer::SearchServer(const StringContainer& stop_words) {
     using namespace std::string_literals;
-    if (std::any_of(stop_words.cbegin(), stop_words.cend(),
-                    [](std::string_view word){return !SearchServer::IsValidWord(word);}))
-    {
-        throw std::invalid_argument("Недопустимые символы (с кодами от 0 до 31) в стоп словах"s);
+    for (std::string_view word : stop_words) {
+        if (const size_t pos = FindInvalidCharacter(word); pos != std::string_view::npos) {
+            throw std::invalid_argument(DescribeInvalidCharacter(word[pos], "в стоп словах"));
+        }
     }
     for (std::string_view word : stop_words) {
         if (!word.empty()) {
@@ -168,79 +502,211 @@ template <typename StringContainer>
             stop_words_.emplace(*it_word);
         }
     }
+    configured_stop_words_ = stop_words_;
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     const QueryOptions& options) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, options);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, DocumentPredicate document_predicate,
+                                                     const QueryOptions& options) const {
+    return SearchServer::FindTopDocumentsImpl(std::execution::seq, query, [this, &document_predicate](int document_id) {
+        const auto& document_data = documents_.at(document_id);
+        return static_cast<bool>(document_predicate(document_id, document_data.status, document_data.rating));
+    }, std::string{}, options);
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& exec_policy,
                                        const std::string_view raw_query,
-                                       DocumentPredicate document_predicate) const {
-    const SearchServer::Query query = SearchServer::ParseQuery(raw_query, std::execution::seq);
-    auto matched_documents = SearchServer::FindAllDocuments(exec_policy, query, document_predicate);
-
-    std::sort(exec_policy, matched_documents.begin(), matched_documents.end(),
-         [](const Document& lhs, const Document& rhs) {
-             if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                 return lhs.rating > rhs.rating;
-             } else {
-                 return lhs.relevance > rhs.relevance;
-             }
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+                                       DocumentPredicate document_predicate,
+                                       const QueryOptions& options) const {
+    return SearchServer::FindTopDocumentsImpl(exec_policy, raw_query, [this, &document_predicate](int document_id) {
+        const auto& document_data = documents_.at(document_id);
+        return static_cast<bool>(document_predicate(document_id, document_data.status, document_data.rating));
+    }, std::string{}, options);
 }
 
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& exec_policy,
-                                                     const std::string_view raw_query, DocumentStatus status) const {
-    return SearchServer::FindTopDocuments(exec_policy, raw_query, [status]([[maybe_unused]] int document_id,
-                                                                                   DocumentStatus lstatus, [[maybe_unused]] int rating){
-        return lstatus == status;});
+                                                     const std::string_view raw_query, DocumentStatus status,
+                                                     const QueryOptions& options) const {
+    const DocumentBitmap& status_documents = SearchServer::GetStatusDocuments(status);
+    const std::string filter_key = result_cache_.Get() ? DocumentFilter::Status({status}).ToString() : std::string{};
+    return SearchServer::FindTopDocumentsImpl(exec_policy, raw_query, [&status_documents](int document_id) {
+        return status_documents.Contains(document_id);
+    }, filter_key, options);
 }
 
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& exec_policy,
-                                                     const std::string_view raw_query) const {
-    return SearchServer::FindTopDocuments(exec_policy, raw_query, DocumentStatus::ACTUAL);
+                                                     const std::string_view raw_query,
+                                                     const QueryOptions& options) const {
+    return SearchServer::FindTopDocuments(exec_policy, raw_query, DocumentStatus::ACTUAL, options);
 }
 
-template <typename ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const ExecutionPolicy& exec_policy, const SearchServer::Query& query, DocumentPredicate document_predicate) const {
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& exec_policy,
+                                                     const std::string_view raw_query,
+                                                     const DocumentFilter& filter,
+                                                     const QueryOptions& options) const {
+    const CompiledDocumentFilter compiled_filter(filter, FilterIndexes{status_to_documents_, rating_to_documents_,
+                                                                       &rating_range_cache_, index_generation_});
+    if (compiled_filter.RejectsAll()) {
+        //запрос все равно разбираем, чтобы некорректный запрос не остался незамеченным
+        std::string normalized_query;
+        [[maybe_unused]] const SearchServer::Query query = SearchServer::ParseQuery(
+                SearchServer::NormalizeText(raw_query, normalized_query), std::execution::seq);
+        if (options.status != nullptr) {
+            *options.status = QueryStatus::COMPLETE;
+        }
+        return {};
+    }
+    const std::string filter_key = result_cache_.Get() ? filter.ToString() : std::string{};
+    return SearchServer::FindTopDocumentsImpl(exec_policy, raw_query, [&compiled_filter](int document_id) {
+        return compiled_filter.Accept(document_id);
+    }, filter_key, options);
+}
+
+template <typename ExecutionPolicy, typename QueryText, typename DocumentAcceptor>
+std::vector<Document> SearchServer::FindTopDocumentsImpl(const ExecutionPolicy& exec_policy,
+                                                         const QueryText& query_text,
+                                                         DocumentAcceptor document_acceptor,
+                                                         const std::string& filter_key,
+                                                         const QueryOptions& options) const {
+    TRACE_SCOPE("FindTopDocuments");
+    ALLOCATION_SCOPE(AllocatingOperation::FIND_TOP_DOCUMENTS);
+    std::string normalized_query;
+    SearchServer::Query parsed_query;
+    const SearchServer::Query& query = SearchServer::GetParsedQuery(query_text, normalized_query, parsed_query);
+
+    QueryResultCache* const cache = filter_key.empty() ? nullptr : result_cache_.Get();
+    std::string cache_key;
+    if (cache != nullptr) {
+        cache_key = SearchServer::MakeResultCacheKey(query, filter_key, options,
+                                                     !std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>);
+        if (auto cached_documents = cache->Find(cache_key, index_generation_)) {
+            if (options.status != nullptr) {
+                *options.status = QueryStatus::COMPLETE;
+            }
+            return std::move(*cached_documents);
+        }
+    }
+
+    QueryInterruption interruption(options);
+    std::vector<Document> matched_documents;
+    if (options.impact_ordered) {
+        matched_documents = SearchServer::FindTopDocumentsByImpact(query, document_acceptor, options, interruption);
+    } else {
+        matched_documents = SearchServer::FindAllDocuments(exec_policy, query, document_acceptor, interruption);
+        //сортируем только первые limit документов, остальные нам не нужны
+        STAGE_TIMER(QueryStage::SELECT);
+        const auto limit = static_cast<size_t>(std::max(options.limit, 0));
+        if (matched_documents.size() > limit) {
+            std::partial_sort(exec_policy, matched_documents.begin(), matched_documents.begin() + limit,
+                              matched_documents.end(), IsMoreRelevant);
+            matched_documents.resize(limit);
+        } else {
+            std::sort(exec_policy, matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
+        }
+    }
+
+    //прерванный запрос либо выбрасывает исключение, либо возвращает неполный результат, который не кешируется
+    interruption.Finish();
+    if (cache != nullptr && interruption.GetStatus() == QueryStatus::COMPLETE) {
+        cache->Insert(cache_key, index_generation_, matched_documents);
+    }
+    return matched_documents;
+}
+
+template <typename ExecutionPolicy, typename DocumentAcceptor>
+std::vector<Document> SearchServer::FindAllDocuments(const ExecutionPolicy& exec_policy, const SearchServer::Query& query,
+                                                     DocumentAcceptor document_acceptor,
+                                                     QueryInterruption& interruption,
+                                                     QueryExplanation::WorkCounters* work,
+                                                     const ResolvedTerms* terms) const {
     ConcurrentMap<int, double> document_to_relevance(1000);
+    //документы с минус-словами отсекаем до начисления релевантности, а не удаляем после
+    const DocumentBitmap excluded_documents = SearchServer::CollectExcludedDocuments(query, terms);
+    //счетчики свои у каждой единицы: единицы могут обрабатываться параллельно
+    struct UnitWork {
+        uint64_t postings_scanned = 0;
+        uint64_t minus_exclusions = 0;
+        uint64_t predicate_evaluations = 0;
+    };
     //сделаем заглушку до распарралеливания
     //так как в параллельной версии тут дубли
     //пока парсинг был без дублей seq версия
     //
-    const auto plus_words_predicate = [this, &document_to_relevance, &document_predicate](std::string_view word) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    const auto add_relevance = [&document_to_relevance, &document_acceptor,
+                                &excluded_documents](int document_id, double relevance, UnitWork& unit_work) {
+        ++unit_work.postings_scanned;
+        if (excluded_documents.Contains(document_id)) {
+            ++unit_work.minus_exclusions;
             return;
         }
-        const double inverse_document_freq = SearchServer::ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq]: word_to_document_freqs_.at(word)) {
-            const auto &document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-            }
+        ++unit_work.predicate_evaluations;
+        if (document_acceptor(document_id)) {
+            document_to_relevance[document_id].ref_to_value += relevance;
         }
     };
-    std::for_each(exec_policy, query.plus_words.begin(), query.plus_words.end(), plus_words_predicate);
-
-    const auto minus_word_predicate =
-            [this, &document_to_relevance](std::string_view word) {
-                if (word_to_document_freqs_.count(word) == 0) {
+    const bool check_interruption = interruption.IsEnabled();
+    const auto scan_unit = [&add_relevance, &interruption, check_interruption](const ScoringUnit& unit,
+                                                                               UnitWork& unit_work) {
+        const auto should_stop = [&interruption, check_interruption, &unit_work] {
+            return check_interruption && unit_work.postings_scanned % QueryInterruption::POSTINGS_PER_CHECK == 0
+                   && interruption.ShouldStop();
+        };
+        if (check_interruption && interruption.ShouldStop()) {
+            return;
+        }
+        //вклад обоих слов пары уже сложен
+        if (unit.pair_postings) {
+            for (const auto& [document_id, relevance] : *unit.pair_postings) {
+                add_relevance(document_id, relevance, unit_work);
+                if (should_stop()) {
                     return;
                 }
-                for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                    document_to_relevance.Erase(document_id);
+            }
+            return;
+        }
+        if (unit.contributions != nullptr) {
+            for (const auto& [document_id, relevance] : *unit.contributions) {
+                add_relevance(document_id, relevance, unit_work);
+                if (should_stop()) {
+                    return;
                 }
-            };
-    std::for_each(exec_policy, query.minus_words.begin(), query.minus_words.end(), minus_word_predicate);
+            }
+            return;
+        }
+        for (const auto [document_id, term_freq]: *unit.document_freqs) {
+            add_relevance(document_id, term_freq * unit.inverse_document_freq, unit_work);
+            if (should_stop()) {
+                return;
+            }
+        }
+    };
+    std::mutex work_mutex;
+    const auto score_unit = [&scan_unit, work, &work_mutex](const ScoringUnit& unit) {
+        TRACE_SCOPE("ScoreUnit");
+        UnitWork unit_work;
+        scan_unit(unit, unit_work);
+        if (work != nullptr) {
+            std::lock_guard guard(work_mutex);
+            work->postings_scanned += unit_work.postings_scanned;
+            work->minus_exclusions += unit_work.minus_exclusions;
+            work->predicate_evaluations += unit_work.predicate_evaluations;
+        }
+    };
+    const std::vector<ScoringUnit> units = SearchServer::PlanScoringUnits(query, terms);
+    STAGE_TIMER(QueryStage::SCORE);
+    SearchServer::ForEachIndex(exec_policy, units.size(), [&units, &score_unit](size_t i) {
+        score_unit(units[i]);
+    });
 
     std::vector<Document> matched_documents;
     for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
@@ -250,6 +716,76 @@ std::vector<Document> SearchServer::FindAllDocuments(const ExecutionPolicy& exec
                                             documents_.at(document_id).rating
                                     );
     }
+    if (work != nullptr) {
+        work->excluded_documents = excluded_documents.Size();
+        work->candidate_documents = matched_documents.size();
+        work->pair_units = static_cast<uint64_t>(std::count_if(units.begin(), units.end(), [](const ScoringUnit& unit) {
+            return unit.pair_postings != nullptr;
+        }));
+    }
+    return matched_documents;
+}
+
+/* Вычисление запроса по постингам, упорядоченным по вкладу (score-at-a-time).
+ * Индекс отбирает кандидатов по квантованной релевантности, а для них
+ * релевантность считается точно.
+ */
+template <typename DocumentAcceptor>
+std::vector<Document> SearchServer::FindTopDocumentsByImpact(const SearchServer::Query& query,
+                                                             DocumentAcceptor document_acceptor,
+                                                             const QueryOptions& options,
+                                                             QueryInterruption& interruption,
+                                                             QueryExplanation::WorkCounters* work) const {
+    std::shared_ptr<const ImpactIndex> index;
+    {
+        STAGE_TIMER(QueryStage::LOOKUP);
+        index = impact_index_.Get(index_generation_, [this] {
+            return ImpactIndex(word_to_document_freqs_, GetDocumentCount());
+        });
+    }
+    const DocumentBitmap excluded_documents = SearchServer::CollectExcludedDocuments(query);
+    //индекс проверяет документ один раз, поэтому и счетчики work здесь - на документ, а не на постинг
+    QueryExplanation::WorkCounters local_work;
+    const auto accept = [&excluded_documents, &document_acceptor, &local_work](int document_id) {
+        if (excluded_documents.Contains(document_id)) {
+            ++local_work.minus_exclusions;
+            return false;
+        }
+        ++local_work.predicate_evaluations;
+        return static_cast<bool>(document_acceptor(document_id));
+    };
+    const auto limit = static_cast<size_t>(std::max(options.limit, 0));
+
+    std::vector<Document> matched_documents;
+    const bool check_interruption = interruption.IsEnabled();
+    uint64_t& scanned = local_work.postings_scanned;
+    const auto should_stop = [&interruption, check_interruption, &scanned] {
+        return ++scanned % QueryInterruption::POSTINGS_PER_CHECK == 0 && check_interruption && interruption.ShouldStop();
+    };
+    {
+        STAGE_TIMER(QueryStage::SCORE);
+        for (const auto& [document_id, _] : index->FindTop(query.plus_words, limit, options.postings_budget, accept,
+                                                           should_stop)) {
+            double relevance = 0.0;
+            for (std::string_view word : query.plus_words) {
+                const auto it = word_to_document_freqs_.find(word);
+                if (it == word_to_document_freqs_.end()) {
+                    continue;
+                }
+                const auto it_document = it->second.find(document_id);
+                if (it_document != it->second.end()) {
+                    relevance += it_document->second * SearchServer::ComputeWordInverseDocumentFreq(word);
+                }
+            }
+            matched_documents.emplace_back(document_id, relevance, documents_.at(document_id).rating);
+        }
+    }
+    if (work != nullptr) {
+        local_work.excluded_documents = excluded_documents.Size();
+        local_work.candidate_documents = matched_documents.size();
+        *work = local_work;
+    }
+    SearchServer::KeepTopDocuments(matched_documents, options.limit);
     return matched_documents;
 }
 
@@ -259,31 +795,59 @@ std::vector<Document> SearchServer::FindAllDocuments(const ExecutionPolicy& exec
 */
 template <typename ExecutionPolicy>
 void SearchServer::RemoveDocument(const ExecutionPolicy& policy, int document_id) {
+    ALLOCATION_SCOPE(AllocatingOperation::REMOVE_DOCUMENT);
     if (!documents_.count(document_id)) {return;}
 
+    ++index_generation_;
+    const auto& document_data = documents_.at(document_id);
+    status_to_documents_[document_data.status].Remove(document_id);
+    auto it_rating = rating_to_documents_.find(document_data.rating);
+    it_rating->second.Remove(document_id);
+    if (it_rating->second.Empty()) {
+        rating_to_documents_.erase(it_rating);
+    }
     documents_.erase(document_id); //Complexity: log(c.size()) + c.count(key)
     document_ids_.erase(document_id); //Complexity: log(c.size()) + c.count(key)
 
     const auto& words_of_doc = document_to_word_freqs_.at(document_id);
-    std::vector<std::string_view> words_to_erase(words_of_doc.size());
-    std::transform(policy, words_of_doc.begin(), words_of_doc.end(),
-                   words_to_erase.begin(),
-                   [](const auto& words_freq){ return words_freq.first;});
+    std::vector<std::string_view> words_to_erase;
+    words_to_erase.reserve(words_of_doc.size());
+    for (const auto& [word, _] : words_of_doc) {
+        words_to_erase.push_back(word);
+    }
 
-    std::for_each(policy, words_to_erase.begin(), words_to_erase.end(),
-                  [this, document_id](const auto& word){word_to_document_freqs_.at(word).erase(document_id);});
+    ForEachIndex(policy, words_to_erase.size(), [this, &words_to_erase, document_id](size_t i) {
+        word_to_document_freqs_.at(words_to_erase[i]).erase(document_id);
+    });
 
     document_to_word_freqs_.erase(document_id); //Complexity: log(c.size()) + c.count(key)
 }
 
+template <typename ExecutionPolicy, typename Func>
+void SearchServer::ForEachIndex(const ExecutionPolicy& exec_policy, size_t count, Func func) const {
+    if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        for (size_t i = 0; i < count; ++i) {
+            func(i);
+        }
+    } else if (thread_pool_) {
+        thread_pool_->ParallelFor(0, count, func);
+    } else {
+        std::vector<size_t> indexes(count);
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(exec_policy, indexes.begin(), indexes.end(), func);
+    }
+}
+
 /* Версия параллельной обработки
  * Перешли на вектора но в данной версии не работаем с уникальностью
  * Разберем запрос на структуру плюс слова и минус слова
  */
 template <typename ExecutionPolicy>
 SearchServer::Query SearchServer::ParseQuery(std::string_view text, [[maybe_unused]] const ExecutionPolicy& exec_policy) const {
+    STAGE_TIMER(QueryStage::PARSE);
     SearchServer::Query query;
-    for (std::string_view word : SplitIntoWordsView(text)) {
+    //недопустимые символы проверяются тем же проходом, что делит запрос на слова
+    const bool is_valid = tokenizer_.ForEachWord(text, [this, &query](std::string_view word) {
         const QueryWord query_word = ParseQueryWord(word);
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
@@ -294,6 +858,10 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view text, [[maybe_unus
                 query.plus_words.push_back(query_word.data);
             }
         }
+    });
+    if (!is_valid) {
+        throw std::invalid_argument("ParseQuery: "s
+                                    + DescribeInvalidCharacter(text[tokenizer_.FindInvalid(text)], "в тексте запроса"));
     }
     //для непараллельной версии нужно удалить дубли, так как дальше они не обрабатываются
     if constexpr(std::is_same_v<std::execution::sequenced_policy, ExecutionPolicy>) {
@@ -311,4 +879,4 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view text, [[maybe_unus
         }
     }
     return query;
-}
\ No newline at end of file
+}
@@ -0,0 +1,102 @@
+#include "search_server_metrics.h"
+
+#include "stage_timings.h"
+
+using namespace std::literals;
+
+namespace {
+
+double GetHitRatio(uint64_t hits, uint64_t misses) {
+    return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(hits + misses);
+}
+
+}  // namespace
+
+void RegisterSearchServerMetrics(MetricsRegistry& registry, const SearchServer& search_server) {
+    const SearchServer* server = &search_server;
+    registry.AddGauge("search_server_documents"s, "Documents in the index."s, [server] {
+        return static_cast<double>(server->GetDocumentCount());
+    });
+    registry.AddGauge("search_server_index_memory_bytes"s, "Estimated memory used by the index."s, [server] {
+        return static_cast<double>(server->GetIndexMemoryUsage());
+    });
+    registry.AddCounter("search_server_ingested_documents_total"s, "Documents added since the server was created."s,
+                        [server] {
+                            return static_cast<double>(server->GetIngestCounters().documents);
+                        });
+    registry.AddCounter("search_server_ingested_words_total"s,
+                        "Words of added documents, including stop words, since the server was created."s, [server] {
+                            return static_cast<double>(server->GetIngestCounters().words);
+                        });
+
+    //выключенный кеш дает нули; включение заново создает кеш, и его счетчики начинаются с нуля
+    const auto result_cache = [server] {
+        const QueryResultCache* cache = server->GetResultCache();
+        return cache == nullptr ? QueryResultCache::Statistics{} : cache->GetStatistics();
+    };
+    registry.AddCounter("search_server_result_cache_hits_total"s, "Result cache hits."s, [result_cache] {
+        return static_cast<double>(result_cache().hits);
+    });
+    registry.AddCounter("search_server_result_cache_misses_total"s, "Result cache misses."s, [result_cache] {
+        return static_cast<double>(result_cache().misses);
+    });
+    registry.AddGauge("search_server_result_cache_entries"s, "Entries in the result cache."s, [result_cache] {
+        return static_cast<double>(result_cache().size);
+    });
+    registry.AddGauge("search_server_result_cache_hit_ratio"s, "Result cache hits to lookups since the cache was enabled."s,
+                      [result_cache] {
+                          const QueryResultCache::Statistics statistics = result_cache();
+                          return GetHitRatio(statistics.hits, statistics.misses);
+                      });
+
+    const auto pair_cache = [server] {
+        const PairPostingCache* cache = server->GetPairPostingCache();
+        return cache == nullptr ? PairPostingCache::Statistics{} : cache->GetStatistics();
+    };
+    registry.AddCounter("search_server_pair_posting_cache_hits_total"s, "Pair posting cache hits."s, [pair_cache] {
+        return static_cast<double>(pair_cache().hits);
+    });
+    registry.AddCounter("search_server_pair_posting_cache_misses_total"s, "Pair posting cache misses."s, [pair_cache] {
+        return static_cast<double>(pair_cache().misses);
+    });
+    registry.AddGauge("search_server_pair_posting_cache_entries"s, "Word pairs in the pair posting cache."s,
+                      [pair_cache] {
+                          return static_cast<double>(pair_cache().size);
+                      });
+    registry.AddGauge("search_server_pair_posting_cache_memory_bytes"s, "Memory used by the pair posting cache."s,
+                      [pair_cache] {
+                          return static_cast<double>(pair_cache().memory_bytes);
+                      });
+    registry.AddGauge("search_server_pair_posting_cache_hit_ratio"s,
+                      "Pair posting cache hits to lookups since the cache was enabled."s, [pair_cache] {
+                          const PairPostingCache::Statistics statistics = pair_cache();
+                          return GetHitRatio(statistics.hits, statistics.misses);
+                      });
+}
+
+void RegisterRequestQueueMetrics(MetricsRegistry& registry, const RequestQueue& request_queue) {
+    const RequestQueue* queue = &request_queue;
+    registry.AddCounter("search_server_requests_total"s, "Search requests handled by the request queue."s, [queue] {
+        return static_cast<double>(queue->GetStatistics(RequestStatistics::Window::TOTAL).requests);
+    });
+    registry.AddCounter("search_server_no_result_requests_total"s, "Search requests that found no documents."s,
+                        [queue] {
+                            return static_cast<double>(
+                                    queue->GetStatistics(RequestStatistics::Window::TOTAL).no_result_requests);
+                        });
+    registry.AddHistogram("search_server_request_duration_seconds"s, "Search request latency."s, [queue] {
+        return queue->GetStatistics(RequestStatistics::Window::TOTAL).latency;
+    });
+}
+
+void RegisterStageTimingMetrics(MetricsRegistry& registry) {
+    //снимок складывает гистограммы всех потоков, поэтому он один на вывод, а не на стадию
+    std::vector<MetricsRegistry::Labels> stage_labels;
+    for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+        stage_labels.push_back({{"stage"s, std::string(StageTimings::GetStageName(static_cast<QueryStage>(stage)))}});
+    }
+    registry.AddHistograms("search_server_stage_duration_seconds"s, "Duration of query and ingest stages."s, [] {
+        const StageTimings::Snapshot snapshot = StageTimings::GetSnapshot();
+        return std::vector<LatencyHistogram>(snapshot.begin(), snapshot.end());
+    }, std::move(stage_labels));
+}
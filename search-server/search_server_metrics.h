@@ -0,0 +1,20 @@
+#pragma once
+
+#include "metrics_registry.h"
+#include "request_queue.h"
+#include "search_server.h"
+
+/*
+ * Регистрация метрик поискового сервера в MetricsRegistry. Значения снимаются при каждом выводе
+ * реестра, поэтому сервер и очередь запросов должны жить дольше реестра, а вывод, как и другие
+ * константные методы сервера, не должен идти одновременно с добавлением и удалением документов.
+ */
+
+// документы, память индекса, добавленные документы и слова, статистика кеша результатов и кеша пар слов
+void RegisterSearchServerMetrics(MetricsRegistry& registry, const SearchServer& search_server);
+
+// запросы очереди с момента ее создания: число, число без результатов и длительности
+void RegisterRequestQueueMetrics(MetricsRegistry& registry, const RequestQueue& request_queue);
+
+// длительности стадий запросов и добавления документов из StageTimings, общие для процесса
+void RegisterStageTimingMetrics(MetricsRegistry& registry);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+/*
+ * Последовательность, хранящая до InlineCapacity элементов внутри объекта, без обращения к куче.
+ * При переполнении элементы переносятся в std::vector. Рассчитана на дешево копируемые
+ * элементы с конструктором по умолчанию, например std::string_view слов запроса.
+ */
+template <typename T, size_t InlineCapacity>
+class SmallVector {
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    void push_back(const T& value) {
+        if (!on_heap_) {
+            if (size_ < InlineCapacity) {
+                inline_[size_++] = value;
+                return;
+            }
+            heap_.reserve(InlineCapacity * 2);
+            heap_.assign(inline_.begin(), inline_.begin() + size_);
+            on_heap_ = true;
+        }
+        heap_.push_back(value);
+        ++size_;
+    }
+
+    // только уменьшение размера
+    void resize(size_t size) {
+        if (size >= size_) {
+            return;
+        }
+        if (on_heap_) {
+            heap_.resize(size);
+        }
+        size_ = size;
+    }
+
+    void clear() {
+        resize(0);
+    }
+
+    [[nodiscard]] size_t size() const {
+        return size_;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size_ == 0;
+    }
+
+    T* data() {
+        return on_heap_ ? heap_.data() : inline_.data();
+    }
+
+    [[nodiscard]] const T* data() const {
+        return on_heap_ ? heap_.data() : inline_.data();
+    }
+
+    T& operator[](size_t index) {
+        return data()[index];
+    }
+
+    const T& operator[](size_t index) const {
+        return data()[index];
+    }
+
+    iterator begin() {
+        return data();
+    }
+
+    iterator end() {
+        return data() + size_;
+    }
+
+    [[nodiscard]] const_iterator begin() const {
+        return data();
+    }
+
+    [[nodiscard]] const_iterator end() const {
+        return data() + size_;
+    }
+
+private:
+    std::array<T, InlineCapacity> inline_{};
+    //используется, только если элементы не поместились в inline_
+    std::vector<T> heap_;
+    bool on_heap_ = false;
+    size_t size_ = 0;
+};
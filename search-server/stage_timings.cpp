@@ -0,0 +1,123 @@
+#include "stage_timings.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+class StageTimingsRegistry {
+public:
+    void Register(StageTimings::Snapshot* histograms) {
+        std::lock_guard guard(mutex_);
+        live_.push_back(histograms);
+    }
+
+    //гистограммы завершающегося потока переносятся в общие
+    void Retire(StageTimings::Snapshot* histograms) {
+        std::lock_guard guard(mutex_);
+        for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+            retired_[stage].Merge((*histograms)[stage]);
+        }
+        live_.erase(std::remove(live_.begin(), live_.end(), histograms), live_.end());
+    }
+
+    StageTimings::Snapshot Collect() const {
+        std::lock_guard guard(mutex_);
+        StageTimings::Snapshot snapshot = retired_;
+        for (const StageTimings::Snapshot* histograms : live_) {
+            for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+                snapshot[stage].Merge((*histograms)[stage]);
+            }
+        }
+        return snapshot;
+    }
+
+    void Reset() {
+        std::lock_guard guard(mutex_);
+        for (StageTimings::Snapshot* histograms : live_) {
+            for (LatencyHistogram& histogram : *histograms) {
+                histogram.Reset();
+            }
+        }
+        for (LatencyHistogram& histogram : retired_) {
+            histogram.Reset();
+        }
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<StageTimings::Snapshot*> live_;
+    StageTimings::Snapshot retired_;
+};
+
+StageTimingsRegistry& GetRegistry() {
+    return GetLeakedInstance<StageTimingsRegistry>();
+}
+
+struct ThreadStageTimings {
+    std::unique_ptr<StageTimings::Snapshot> histograms = std::make_unique<StageTimings::Snapshot>();
+
+    ThreadStageTimings() {
+        GetRegistry().Register(histograms.get());
+    }
+
+    ~ThreadStageTimings() {
+        GetRegistry().Retire(histograms.get());
+    }
+};
+
+thread_local StageTimings::Durations* captured_durations = nullptr;
+
+}  // namespace
+
+StageTimings::CaptureScope::CaptureScope(Durations& durations)
+        : previous_(captured_durations) {
+    captured_durations = &durations;
+}
+
+StageTimings::CaptureScope::~CaptureScope() {
+    captured_durations = previous_;
+}
+
+void StageTimings::Record(QueryStage stage, std::chrono::nanoseconds duration) {
+    if (captured_durations != nullptr) {
+        (*captured_durations)[static_cast<size_t>(stage)] += duration;
+        return;
+    }
+    thread_local ThreadStageTimings thread_timings;
+    (*thread_timings.histograms)[static_cast<size_t>(stage)].Record(duration);
+}
+
+bool StageTimings::IsCaptured() {
+    return captured_durations != nullptr;
+}
+
+StageTimings::Snapshot StageTimings::GetSnapshot() {
+    return GetRegistry().Collect();
+}
+
+void StageTimings::Reset() {
+    GetRegistry().Reset();
+}
+
+std::string_view StageTimings::GetStageName(QueryStage stage) {
+    switch (stage) {
+        case QueryStage::PARSE:
+            return "parse"sv;
+        case QueryStage::LOOKUP:
+            return "lookup"sv;
+        case QueryStage::MINUS_FILTER:
+            return "minus_filter"sv;
+        case QueryStage::SCORE:
+            return "score"sv;
+        case QueryStage::SELECT:
+            return "select"sv;
+        case QueryStage::INGEST:
+            return "ingest"sv;
+    }
+    return "unknown"sv;
+}
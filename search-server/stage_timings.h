@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+#include "instrumentation.h"
+#include "latency_histogram.h"
+#include "perf_counters.h"
+#include "query_stage.h"
+
+/*
+ * Замеры длительности стадий поискового запроса. Сборка с -DSEARCH_SERVER_STAGE_TIMINGS=0
+ * убирает замеры из кода полностью: STAGE_TIMER раскрывается в пустоту.
+ */
+#ifndef SEARCH_SERVER_STAGE_TIMINGS
+#define SEARCH_SERVER_STAGE_TIMINGS 1
+#endif
+
+/*
+ * Гистограммы длительностей стадий всех запросов процесса. Каждый поток пишет в свои гистограммы
+ * без блокировок; GetSnapshot складывает гистограммы всех потоков, в том числе завершившихся.
+ */
+class StageTimings {
+public:
+    using Snapshot = std::array<LatencyHistogram, QUERY_STAGE_COUNT>;
+    using Durations = std::array<std::chrono::nanoseconds, QUERY_STAGE_COUNT>;
+
+    /* Пока объект жив, замеры стадий своего потока складываются в durations, а не в общие
+     * гистограммы и PerfCounters: так разбор отдельного запроса не попадает в статистику процесса
+     */
+    class CaptureScope {
+    public:
+        explicit CaptureScope(Durations& durations);
+        CaptureScope(const CaptureScope&) = delete;
+        CaptureScope& operator=(const CaptureScope&) = delete;
+        ~CaptureScope();
+
+    private:
+        Durations* previous_;
+    };
+
+    static void Record(QueryStage stage, std::chrono::nanoseconds duration);
+    // true, если замеры потока перехватывает CaptureScope
+    [[nodiscard]] static bool IsCaptured();
+    [[nodiscard]] static Snapshot GetSnapshot();
+    static void Reset();
+
+    [[nodiscard]] static std::string_view GetStageName(QueryStage stage);
+};
+
+/* Записывает в StageTimings время от создания до конца блока, а если включены PerfCounters -
+ * и приращения аппаратных счетчиков потока
+ */
+class StageTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit StageTimer(QueryStage stage)
+            : stage_(stage) {
+        if (PerfCounters::IsEnabled() && !StageTimings::IsCaptured()) {
+            perf_start_ = PerfCounters::ReadThread();
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    ~StageTimer() {
+        StageTimings::Record(stage_, Clock::now() - start_time_);
+        if (perf_start_) {
+            if (const auto perf_end = PerfCounters::ReadThread()) {
+                PerfCounters::Record(stage_, *perf_end - *perf_start_);
+            }
+        }
+    }
+
+private:
+    QueryStage stage_;
+    std::optional<PerfValues> perf_start_;
+    Clock::time_point start_time_ = Clock::now();
+};
+
+#if SEARCH_SERVER_STAGE_TIMINGS
+#define STAGE_TIMER(stage) StageTimer PROFILE_CONCAT(stageTimer, __LINE__)(stage)
+#else
+#define STAGE_TIMER(stage)
+#endif
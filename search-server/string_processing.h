@@ -1,8 +1,10 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <set>
 #include <vector>
+#include <algorithm>
 
 template <typename StringContainer>
 [[maybe_unused]] std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings);
@@ -12,6 +14,10 @@ template <typename StringContainer>
 //функция разделяет переданную строку на слова но работает со string_view
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str);
 
+//вызывает callback(word) для каждого слова строки, не собирая слова в контейнер
+template <typename Callback>
+void ForEachWord(std::string_view str, Callback callback);
+
 //template function realize
 template <typename StringContainer>
 [[maybe_unused]] std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
@@ -22,4 +28,14 @@ template <typename StringContainer>
         }
     }
     return non_empty_strings;
-}
\ No newline at end of file
+}
+
+template <typename Callback>
+void ForEachWord(std::string_view str, Callback callback) {
+    str.remove_prefix(std::min(str.find_first_not_of(' '), str.size()));
+    while (!str.empty()) {
+        const std::string_view::size_type space = str.find(' ');
+        callback(str.substr(0, space));
+        str.remove_prefix(std::min(str.find_first_not_of(' ', space), str.size()));
+    }
+}
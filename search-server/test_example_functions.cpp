@@ -54,4 +54,13 @@ void FindTopDocuments(const SearchServer& search_server, const std::string& raw_
     } catch (const std::exception& e) {
         std::cout << "Ошибка матчинга документов на запрос "s << query << ": "s << e.what() << std::endl;
     }
-}
\ No newline at end of file
+}
+
+void PrintIndexStatistics(std::istream& input, std::string_view stop_words, size_t top_count) {
+    SearchServer search_server(stop_words);
+    int document_id = 0;
+    for (std::string line; std::getline(input, line); ++document_id) {
+        AddDocument(search_server, document_id, line, DocumentStatus::ACTUAL, {});
+    }
+    std::cout << search_server.GetIndexStatistics(top_count);
+}
@@ -3,6 +3,7 @@
 //
 #pragma once
 
+#include <istream>
 #include <vector>
 #include <string>
 #include "document.h"
@@ -17,4 +18,7 @@ void PrintDocument(const Document& document);
                  const std::vector<int>& ratings);
 void FindTopDocuments(const SearchServer& search_server, const std::string& raw_query);
 
-[[maybe_unused]] void MatchDocuments(const SearchServer& search_server, const std::string& query);
\ No newline at end of file
+[[maybe_unused]] void MatchDocuments(const SearchServer& search_server, const std::string& query);
+
+// добавляет документы из input, по одному в строке, и выводит сводку GetIndexStatistics
+void PrintIndexStatistics(std::istream& input, std::string_view stop_words, size_t top_count = 10);
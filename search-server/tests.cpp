@@ -1,8 +1,20 @@
 //
 // Created by Родион Каргаполов on 22.03.2022.
 //
+#include <atomic>
+#include <functional>
+#include <future>
+#include <sstream>
+#include <thread>
+
 #include "tests.h"
 #include "search_server.h"
+#include "document_bitmap.h"
+#include "case_folding.h"
+#include "process_queries.h"
+#include "admission_control.h"
+#include "request_queue.h"
+#include "search_server_metrics.h"
 
 // -------- Начало модульных тестов поисковой системы ----------
 void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func, unsigned line,
@@ -267,6 +279,1232 @@ void TestRelevanceCalc() {
 
 }
 
+void TestResultLimit() {
+    /*
+     * Количество возвращаемых документов задается в QueryOptions, по умолчанию MAX_RESULT_DOCUMENT_COUNT.
+     */
+    {
+        SearchServer server;
+        for (int doc_id = 0; doc_id < 20; ++doc_id) {
+            server.AddDocument(doc_id, "cat in the city "s + std::string(doc_id, 'x'), DocumentStatus::ACTUAL, {doc_id});
+        }
+        ASSERT_EQUAL(server.FindTopDocuments("city"s).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+        ASSERT_EQUAL(server.FindTopDocuments("city"s, QueryOptions{12}).size(), 12u);
+        ASSERT_EQUAL(server.FindTopDocuments("city"s, DocumentStatus::ACTUAL, QueryOptions{50}).size(), 20u);
+        ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, "city"s, QueryOptions{1}).size(), 1u);
+        ASSERT_HINT(server.FindTopDocuments("city"s, QueryOptions{0}).empty(), "Zero limit must return nothing"s);
+
+        const auto top = server.FindTopDocuments("cat x"s, QueryOptions{7});
+        const auto all = server.FindTopDocuments("cat x"s, QueryOptions{20});
+        for (size_t i = 0; i < top.size(); ++i) {
+            ASSERT_EQUAL_HINT(top[i].id, all[i].id, "Top-k must be a prefix of the full ranking"s);
+        }
+    }
+}
+
+void TestImpactOrderedSearch() {
+    /*
+     * Поиск по постингам, упорядоченным по вкладу, без бюджета возвращает тот же top-k, что и точный поиск,
+     * и видит документы, добавленные после предыдущего запроса.
+     */
+    SearchServer server("and in the"s);
+    server.AddDocument(1, "white cat and yellow hat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "curly cat curly tail"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "nasty dog with big eyes"s, DocumentStatus::ACTUAL, {3});
+    server.AddDocument(4, "nasty pigeon john"s, DocumentStatus::ACTUAL, {4});
+    server.AddDocument(5, "big cat in the city"s, DocumentStatus::BANNED, {5});
+
+    QueryOptions impact_options;
+    impact_options.impact_ordered = true;
+    impact_options.limit = 2;
+    const auto exact = server.FindTopDocuments("curly nasty cat"s, QueryOptions{2});
+    const auto by_impact = server.FindTopDocuments("curly nasty cat"s, impact_options);
+    ASSERT_EQUAL(by_impact.size(), exact.size());
+    for (size_t i = 0; i < exact.size(); ++i) {
+        ASSERT_EQUAL(by_impact[i].id, exact[i].id);
+        ASSERT_HINT(std::abs(by_impact[i].relevance - exact[i].relevance) < EPSILON, "Relevance must be exact"s);
+    }
+    ASSERT_HINT(server.FindTopDocuments("cat -curly"s, DocumentStatus::BANNED, impact_options).size() == 1u,
+                "Predicate and minus words must be applied"s);
+
+    server.AddDocument(6, "curly curly curly"s, DocumentStatus::ACTUAL, {6});
+    ASSERT_EQUAL_HINT(server.FindTopDocuments("curly"s, impact_options)[0].id, 6,
+                      "Impact index must be rebuilt after corpus change"s);
+
+    impact_options.postings_budget = 1;
+    ASSERT_EQUAL(server.FindTopDocuments("curly nasty cat"s, impact_options).size(), 1u);
+
+    //корпус, в котором top-k много раз меняется по ходу обхода
+    SearchServer large(""s);
+    for (int id = 0; id < 300; ++id) {
+        std::string text;
+        for (int word = 0; word < 8; ++word) {
+            for (int repeat = (id * (word + 3) + word) % 5; repeat > 0; --repeat) {
+                text += "w"s + std::to_string(word) + ' ';
+            }
+        }
+        large.AddDocument(id, text + "id"s + std::to_string(id), DocumentStatus::ACTUAL, {id % 7});
+    }
+    impact_options.postings_budget = 0;
+    impact_options.limit = 5;
+    for (const std::string& query : {"w1 w2"s, "w0 w3 w5 w7"s, "w4 -w6"s, "w2 w6 id17"s}) {
+        const auto large_exact = large.FindTopDocuments(query, QueryOptions{5});
+        const auto large_by_impact = large.FindTopDocuments(query, impact_options);
+        ASSERT_EQUAL(large_by_impact.size(), large_exact.size());
+        for (size_t i = 0; i < large_exact.size(); ++i) {
+            ASSERT_HINT(std::abs(large_by_impact[i].relevance - large_exact[i].relevance) < EPSILON,
+                        "Early termination must keep the exact top-k"s);
+        }
+    }
+}
+
+void TestDocumentBitmap() {
+    /*
+     * Сжатое множество id документов: массив младших половин id переходит в битовую карту и обратно.
+     */
+    DocumentBitmap bitmap;
+    ASSERT(bitmap.Empty());
+    for (int document_id = 10'000; document_id >= 0; document_id -= 2) {
+        bitmap.Add(document_id);
+    }
+    bitmap.Add(1 << 20);
+    bitmap.Add(1 << 20);
+    ASSERT_EQUAL(bitmap.Size(), 5002u);
+    ASSERT(bitmap.Contains(0) && bitmap.Contains(9'998) && bitmap.Contains(1 << 20));
+    ASSERT(!bitmap.Contains(1) && !bitmap.Contains(10'001) && !bitmap.Contains((1 << 20) + 2));
+
+    for (int document_id = 0; document_id < 8'000; document_id += 2) {
+        bitmap.Remove(document_id);
+    }
+    bitmap.Remove(1 << 20);
+    ASSERT_EQUAL(bitmap.Size(), 1001u);
+    ASSERT(!bitmap.Contains(7'998) && bitmap.Contains(8'000) && !bitmap.Contains(1 << 20));
+
+    DocumentBitmap odd;
+    for (int document_id = 1; document_id < 20'000; document_id += 2) {
+        odd.Add(document_id);
+    }
+    bitmap |= odd;
+    ASSERT_EQUAL(bitmap.Size(), 11001u);
+    ASSERT(bitmap.Contains(8'001) && bitmap.Contains(8'002) && !bitmap.Contains(7'998));
+    const DocumentBitmap& same = bitmap;
+    bitmap |= same;
+    ASSERT_EQUAL_HINT(bitmap.Size(), 11001u, "Union with itself must keep the set"s);
+    ASSERT(bitmap.Contains(8'001) && bitmap.Contains(1'001));
+}
+
+void TestFindByStatusAfterRemove() {
+    /*
+     * Поиск по статусу учитывает удаленные документы и документы, добавленные после удаления.
+     */
+    SearchServer server;
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "dog in the city"s, DocumentStatus::BANNED, {2});
+    server.AddDocument(3, "bird in the city"s, DocumentStatus::BANNED, {3});
+    ASSERT_EQUAL(server.FindTopDocuments("city"s, DocumentStatus::BANNED).size(), 2u);
+
+    server.RemoveDocument(2);
+    const auto banned = server.FindTopDocuments("city"s, DocumentStatus::BANNED);
+    ASSERT_EQUAL(banned.size(), 1u);
+    ASSERT_EQUAL(banned[0].id, 3);
+
+    server.AddDocument(2, "dog in the city"s, DocumentStatus::ACTUAL, {2});
+    ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, "city"s).size(), 2u);
+    ASSERT_EQUAL(server.FindTopDocuments("city"s, DocumentStatus::REMOVED).size(), 0u);
+}
+
+void TestFilterByDocumentFilter() {
+    /*
+     * Структурированный фильтр отбирает те же документы, что и эквивалентный предикат.
+     */
+    SearchServer server;
+    for (int doc_id = 0; doc_id < 30; ++doc_id) {
+        const auto status = doc_id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.AddDocument(doc_id, "cat in the city "s + std::string(doc_id, 'x'), status, {doc_id % 10});
+    }
+    const QueryOptions all_documents{100};
+
+    const auto filter = DocumentFilter::AnyOf({
+        DocumentFilter::AllOf({DocumentFilter::Status({DocumentStatus::ACTUAL}),
+                               DocumentFilter::RatingRange(5, 7),
+                               DocumentFilter::IdNotIn({5})}),
+        DocumentFilter::IdIn({3, 4}),
+        DocumentFilter::AllOf({DocumentFilter::IdRange(20, 22), DocumentFilter::Status({DocumentStatus::BANNED})})
+    });
+    const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+        return (status == DocumentStatus::ACTUAL && rating >= 5 && rating <= 7 && document_id != 5)
+               || document_id == 3 || document_id == 4
+               || (document_id >= 20 && document_id <= 22 && status == DocumentStatus::BANNED);
+    };
+    const auto by_filter = server.FindTopDocuments("city"s, filter, all_documents);
+    const auto by_predicate = server.FindTopDocuments("city"s, predicate, all_documents);
+    ASSERT_EQUAL(by_filter.size(), by_predicate.size());
+    for (size_t i = 0; i < by_filter.size(); ++i) {
+        ASSERT_EQUAL(by_filter[i].id, by_predicate[i].id);
+    }
+    ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, "city"s, filter, all_documents).size(), by_filter.size());
+
+    ASSERT_EQUAL(server.FindTopDocuments("city"s, DocumentFilter(), all_documents).size(), 30u);
+    //диапазоны рейтинга: из нескольких корзин, почти всех корзин и без единого документа
+    for (const auto& [min_rating, max_rating] : std::vector<std::pair<int, int>>{{0, 9}, {2, 8}, {1, 1}, {3, 7}, {-5, -1}}) {
+        const auto in_range = server.FindTopDocuments("city"s, DocumentFilter::RatingRange(min_rating, max_rating),
+                                                      all_documents);
+        const auto by_predicate = server.FindTopDocuments("city"s, [&min_rating = min_rating, &max_rating = max_rating](
+                [[maybe_unused]] int document_id, [[maybe_unused]] DocumentStatus status, int rating) {
+            return rating >= min_rating && rating <= max_rating;
+        }, all_documents);
+        ASSERT_EQUAL(in_range.size(), by_predicate.size());
+    }
+    //объединение корзин широкого диапазона переиспользуется, пока не изменится индекс
+    const DocumentFilter wide_range = DocumentFilter::RatingRange(3, 7);
+    const size_t wide_range_count = server.FindTopDocuments("city"s, wide_range, all_documents).size();
+    ASSERT_EQUAL(server.FindTopDocuments("city"s, wide_range, all_documents).size(), wide_range_count);
+    server.AddDocument(40, "city"s, DocumentStatus::ACTUAL, {5});
+    ASSERT_EQUAL(server.FindTopDocuments("city"s, wide_range, all_documents).size(), wide_range_count + 1);
+    server.RemoveDocument(40);
+    ASSERT_EQUAL(server.FindTopDocuments("city"s, wide_range, all_documents).size(), wide_range_count);
+    server.RemoveDocument(1);
+    server.RemoveDocument(11);
+    server.RemoveDocument(21);
+    ASSERT(server.FindTopDocuments("city"s, DocumentFilter::RatingRange(1, 1)).empty());
+    ASSERT(server.FindTopDocuments("city"s, DocumentFilter::Status({DocumentStatus::REMOVED})).empty());
+    ASSERT(server.FindTopDocuments("city"s, DocumentFilter::AllOf({DocumentFilter::IdIn({1}),
+                                                                    DocumentFilter::IdIn({2})})).empty());
+}
+
+void TestResultCache() {
+    /*
+     * Кеш результатов отдает сохраненный результат для того же нормализованного запроса
+     * и перестает его отдавать после изменения индекса.
+     */
+    SearchServer server("in the"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "dog in the city"s, DocumentStatus::ACTUAL, {2});
+    ASSERT(server.GetResultCache() == nullptr);
+    server.EnableResultCache(100, 4);
+
+    const auto first = server.FindTopDocuments("city cat -dog"s);
+    const auto second = server.FindTopDocuments("-dog cat city cat"s);
+    ASSERT_EQUAL(first.size(), 1u);
+    ASSERT_EQUAL(second.size(), 1u);
+    ASSERT_EQUAL(server.GetResultCache()->GetStatistics().hits, 1u);
+    ASSERT_EQUAL(server.GetResultCache()->GetStatistics().misses, 1u);
+
+    ASSERT_EQUAL(server.FindTopDocuments("city cat -dog"s, QueryOptions{1}).size(), 1u);
+    ASSERT(server.FindTopDocuments("city cat -dog"s, DocumentStatus::BANNED).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("city cat -dog"s, [](int, DocumentStatus, int) { return true; }).size(), 1u);
+    ASSERT_EQUAL_HINT(server.GetResultCache()->GetStatistics().hits, 1u, "Limit and status are part of the key"s);
+    ASSERT_EQUAL(server.GetResultCache()->GetStatistics().size, 3u);
+
+    server.AddDocument(3, "cat cat cat"s, DocumentStatus::ACTUAL, {3});
+    const auto after_add = server.FindTopDocuments("city cat -dog"s);
+    ASSERT_EQUAL_HINT(after_add.size(), 2u, "Cache must be invalidated by AddDocument"s);
+    ASSERT_EQUAL(server.GetResultCache()->GetStatistics().hits, 1u);
+
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentFilter::RatingRange(3, 3)).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentFilter::RatingRange(1, 1)).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentFilter::RatingRange(3, 3)).size(), 1u);
+    ASSERT_EQUAL(server.GetResultCache()->GetStatistics().hits, 2u);
+}
+
+void TestPairPostingCache() {
+    /*
+     * Частая пара плюс-слов кешируется с уже сложенным вкладом обоих слов,
+     * а результат поиска совпадает с поиском без кеша, в том числе после изменения индекса.
+     */
+    SearchServer reference("in the"s);
+    reference.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+    reference.AddDocument(2, "dog in the city"s, DocumentStatus::ACTUAL, {2});
+    reference.AddDocument(3, "cat and dog"s, DocumentStatus::ACTUAL, {3});
+    reference.AddDocument(4, "big bird"s, DocumentStatus::ACTUAL, {4});
+    SearchServer server = reference;
+    server.EnablePairPostingCache(1 << 20, 2);
+
+    const auto assert_same = [&reference, &server](const std::string& query) {
+        const auto expected = reference.FindTopDocuments(query);
+        const auto actual = server.FindTopDocuments(query);
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(actual[i].id, expected[i].id);
+            ASSERT(std::abs(actual[i].relevance - expected[i].relevance) < EPSILON);
+        }
+    };
+    assert_same("cat city"s);
+    ASSERT_EQUAL(server.GetPairPostingCache()->GetStatistics().admissions, 0u);
+    assert_same("city cat -dog"s);
+    ASSERT_EQUAL_HINT(server.GetPairPostingCache()->GetStatistics().admissions, 1u,
+                      "Pair is admitted on its second query"s);
+    assert_same("cat city bird"s);
+    ASSERT_EQUAL(server.GetPairPostingCache()->GetStatistics().hits, 1u);
+
+    reference.AddDocument(5, "city cat"s, DocumentStatus::ACTUAL, {5});
+    server.AddDocument(5, "city cat"s, DocumentStatus::ACTUAL, {5});
+    assert_same("cat city"s);
+    ASSERT_EQUAL_HINT(server.GetPairPostingCache()->GetStatistics().hits, 1u,
+                      "Pair must be rebuilt after AddDocument"s);
+
+    SearchServer eager = reference;
+    eager.EnablePairPostingCache(1 << 20, 1);
+    const auto eager_documents = eager.FindTopDocuments("cat city dog"s);
+    ASSERT_EQUAL(eager_documents.size(), reference.FindTopDocuments("cat city dog"s).size());
+    ASSERT_EQUAL_HINT(eager.GetPairPostingCache()->GetStatistics().admissions, 1u,
+                      "Pairs with an already paired word must not be built"s);
+
+    SearchServer tiny_budget = reference;
+    tiny_budget.EnablePairPostingCache(0, 1);
+    ASSERT_EQUAL(tiny_budget.FindTopDocuments("cat city"s).size(), 4u);
+    ASSERT_EQUAL(tiny_budget.GetPairPostingCache()->GetStatistics().size, 0u);
+}
+
+void TestLongQuery() {
+    /*
+     * Запрос, слова которого не помещаются во встроенный буфер разбора, обрабатывается так же, как короткий.
+     */
+    SearchServer server("in the"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "dog in the city"s, DocumentStatus::ACTUAL, {2});
+    std::string query;
+    for (int i = 0; i < 40; ++i) {
+        query += "word"s + std::to_string(i) + " -minus"s + std::to_string(i) + " "s;
+    }
+    ASSERT(server.FindTopDocuments(query).empty());
+    ASSERT_EQUAL(server.FindTopDocuments(query + "cat cat -dog"s).size(), 1u);
+    const auto [words, status] = server.MatchDocument(query + "city cat"s, 1);
+    ASSERT_EQUAL(words.size(), 2u);
+}
+
+void TestTokenizer() {
+    /*
+     * Токенизатор делит текст на слова по таблице классов символов и за тот же проход
+     * находит недопустимые символы, в том числе за пределами первого блока байтов.
+     */
+    const auto split = [](const Tokenizer& tokenizer, std::string_view text, bool& is_valid) {
+        std::vector<std::string_view> words;
+        is_valid = tokenizer.ForEachWord(text, [&words](std::string_view word) { words.push_back(word); });
+        return words;
+    };
+    const Tokenizer tokenizer;
+    bool is_valid = false;
+    std::string text = "  белый кот  и модный ошейник "s;
+    ASSERT_EQUAL(split(tokenizer, text, is_valid).size(), 5u);
+    ASSERT(is_valid);
+
+    std::string long_text;
+    for (int i = 0; i < 20; ++i) {
+        long_text += "word"s + std::to_string(i) + "   "s;
+    }
+    const auto long_words = split(tokenizer, long_text, is_valid);
+    ASSERT(is_valid);
+    ASSERT_EQUAL(long_words.size(), 20u);
+    ASSERT_EQUAL(long_words.back(), "word19"s);
+    for (size_t pos : {0u, 17u, 40u, 95u, static_cast<unsigned>(long_text.size() - 1)}) {
+        std::string broken = long_text;
+        broken[pos] = '\x12';
+        split(tokenizer, broken, is_valid);
+        ASSERT_HINT(!is_valid, "Control character at "s + std::to_string(pos) + " must be found"s);
+        ASSERT_EQUAL(tokenizer.FindInvalid(broken), pos);
+    }
+    ASSERT_EQUAL(tokenizer.FindInvalid(long_text), std::string_view::npos);
+
+    const Tokenizer punctuation(Tokenizer::DefaultTableWithDelimiters("\t,.!"s));
+    const auto words = split(punctuation, "cat,dog.\tbird!!", is_valid);
+    ASSERT(is_valid);
+    ASSERT_EQUAL(words.size(), 3u);
+    ASSERT_EQUAL(words[1], "dog"s);
+
+    SearchServer server;
+    server.SetCharClassTable(Tokenizer::DefaultTableWithDelimiters(",."s));
+    server.AddDocument(1, "cat,dog"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(server.FindTopDocuments("dog"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("bird.-dog"s).size(), 0u);
+
+    //в сообщении об ошибке - код символа, недопустимого по таблице сервера
+    Tokenizer::CharClassTable table = Tokenizer::DefaultTable();
+    table[static_cast<uint8_t>('#')] = Tokenizer::CharClass::INVALID;
+    SearchServer strict;
+    strict.SetCharClassTable(table);
+    std::string message;
+    try {
+        strict.AddDocument(1, "cat #dog"s, DocumentStatus::ACTUAL, {1});
+    } catch (const std::invalid_argument& error) {
+        message = error.what();
+    }
+    ASSERT_HINT(message.find("кодом 35"s) != std::string::npos, message);
+}
+
+void TestCaseFolding() {
+    /*
+     * При включенном приведении к нижнему регистру варианты написания слова в документах,
+     * запросах и стоп-словах совпадают; без него остаются разными словами.
+     */
+    std::string storage;
+    ASSERT_EQUAL(FoldCase("кот и пёс"s, storage), "кот и пёс"s);
+    ASSERT(storage.empty());
+    ASSERT_EQUAL(FoldCase("Кот И ПЁС, Cat AND DOG"s, storage), "кот и пёс, cat and dog"s);
+    ASSERT_EQUAL(FoldCase("ЁЖ ЯЩИК ЄЇ"s, storage), "ёж ящик єї"s);
+    ASSERT_EQUAL(FoldCase("ÀÉÎ ŁŻ ΑΩ Ά ԱՖ"s, storage), "àéî łż αω ά աֆ"s);
+    ASSERT_EQUAL_HINT(FoldCase("AB\xD0\xC3"s, storage), "ab\xD0\xC3"s, "Invalid UTF-8 must be kept as is"s);
+    //Ạ Ḁ Ỳ ẞ, Ἀ Ά ῼ, Ⴀ Ა, Ａ Ｚ
+    ASSERT_EQUAL(FoldCase("\u1EA0\u1E00 \u1EF2\u1E9E \u1F08\u1FBB\u1FFC \u10A0\u1C90 \uFF21\uFF3A"s, storage),
+                 "\u1EA1\u1E01 \u1EF3\u1E9E \u1F00\u1F71\u1FF3 \u2D00\u10D0 \uFF41\uFF5A"s);
+    ASSERT_EQUAL(FoldCase("漢字 😀"s, storage), "漢字 😀"s);
+    ASSERT_EQUAL_HINT(FoldCase("\xE1\xBA""AB \xF0\x9F""CD"s, storage), "\xE1\xBA""ab \xF0\x9F""cd"s,
+                      "A truncated sequence must not swallow the following letters"s);
+
+    SearchServer plain("и"s);
+    plain.AddDocument(1, "Кот и пёс"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(plain.FindTopDocuments("кот"s).empty());
+
+    SearchServer server("И в"s);
+    server.SetCaseFolding(true);
+    server.AddDocument(1, "Кот И пёс"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "КОТ в сапогах"s, DocumentStatus::ACTUAL, {2});
+    ASSERT_EQUAL(server.FindTopDocuments("кот"s).size(), 2u);
+    ASSERT_EQUAL(server.FindTopDocuments("КоТ -САПОГАХ"s).size(), 1u);
+    ASSERT(server.FindTopDocuments("и"s).empty());
+    const auto [words, status] = server.MatchDocument("ПЁС Кот"s, 1);
+    ASSERT_EQUAL(words.size(), 2u);
+    ASSERT_EQUAL(words[0], "кот"s);
+
+    SearchServer toggled("And"s);
+    toggled.SetCaseFolding(true);
+    toggled.SetCaseFolding(false);
+    toggled.AddDocument(1, "cat And dog"s, DocumentStatus::ACTUAL, {1});
+    toggled.AddDocument(2, "cat and dog"s, DocumentStatus::ACTUAL, {2});
+    ASSERT_EQUAL_HINT(toggled.FindTopDocuments("And"s).size(), 0u,
+                      "Stop words must be case-sensitive again after folding is turned off"s);
+    ASSERT_EQUAL(toggled.FindTopDocuments("and"s).size(), 1u);
+}
+
+void TestProcessQueriesBatch() {
+    /*
+     * Пакетное выполнение дает те же результаты, что и FindTopDocuments для каждого запроса,
+     * в том числе для повторяющихся запросов и слов, общих для нескольких запросов.
+     */
+    SearchServer server("and with"s);
+    int id = 0;
+    for (const std::string& text : {"funny pet and nasty rat"s, "funny pet with curly hair"s, "funny pet and not very nasty rat"s,
+                                    "pet with rat and rat and rat"s, "nasty rat with curly hair"s}) {
+        server.AddDocument(++id, text, DocumentStatus::ACTUAL, {id});
+    }
+    server.AddDocument(++id, "banned nasty pet"s, DocumentStatus::BANNED, {id});
+    const std::vector<std::string> queries = {"nasty rat -not"s, "not very funny nasty pet"s, "curly hair"s,
+                                              "rat nasty -not"s, "nasty rat -not"s, "unknown"s, "pet -rat"s};
+    for (const QueryOptions& options : {QueryOptions{}, QueryOptions{2}, QueryOptions{5, true}}) {
+        const auto results = ProcessQueries(server, queries, options);
+        ASSERT_EQUAL(results.size(), queries.size());
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto expected = server.FindTopDocuments(queries[i], options);
+            ASSERT_EQUAL(results[i].size(), expected.size());
+            for (size_t j = 0; j < expected.size(); ++j) {
+                ASSERT_EQUAL(results[i][j].id, expected[j].id);
+                ASSERT(std::abs(results[i][j].relevance - expected[j].relevance) < EPSILON);
+            }
+        }
+    }
+
+    //пакет считает запросы тем же кодом, что FindTopDocuments, и берет пары слов из кеша пар
+    server.EnablePairPostingCache(1 << 20, 1);
+    const auto paired_results = ProcessQueries(server, queries);
+    ASSERT(server.GetPairPostingCache()->GetStatistics().admissions > 0);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = server.FindTopDocuments(queries[i]);
+        ASSERT_EQUAL(paired_results[i].size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j) {
+            ASSERT_EQUAL(paired_results[i][j].id, expected[j].id);
+            ASSERT(std::abs(paired_results[i][j].relevance - expected[j].relevance) < EPSILON);
+        }
+    }
+    server.DisablePairPostingCache();
+
+    server.EnableResultCache(100);
+    ProcessQueries(server, queries);
+    ASSERT_EQUAL_HINT(server.GetResultCache()->GetStatistics().misses, 5u, "Duplicate queries run once"s);
+    ASSERT_EQUAL(server.FindTopDocuments("rat -not nasty"s).size(), 3u);
+    ASSERT_EQUAL(server.GetResultCache()->GetStatistics().hits, 1u);
+}
+
+void TestProcessQueriesJoined() {
+    /*
+     * Плоский результат содержит документы всех запросов подряд, в порядке запросов,
+     * и дает доступ к документам каждого запроса по его номеру.
+     */
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, {3});
+    const std::vector<std::string> queries = {"nasty rat"s, "unknown"s, "curly"s, "nasty rat"s};
+    const auto expected = ProcessQueries(server, queries);
+    const JoinedDocuments joined = ProcessQueriesJoined(server, queries);
+
+    ASSERT_EQUAL(joined.GetQueryCount(), queries.size());
+    ASSERT_EQUAL(joined.size(), 6u);
+    std::vector<int> ids;
+    for (const Document& document : joined) {
+        ids.push_back(document.id);
+    }
+    std::vector<int> expected_ids;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        ASSERT_EQUAL(joined[i].size(), expected[i].size());
+        for (size_t j = 0; j < expected[i].size(); ++j) {
+            ASSERT_EQUAL(joined[i][j].id, expected[i][j].id);
+            expected_ids.push_back(expected[i][j].id);
+        }
+    }
+    ASSERT(joined[1].empty());
+    ASSERT(ids == expected_ids);
+    ASSERT(ProcessQueriesJoined(server, {}).empty());
+
+    //результаты из кеша и с ограничением limit сдвигаются так же, повтор копируется из первого запроса
+    server.EnableResultCache(16);
+    for (int limit : {0, 1, 2}) {
+        const QueryOptions options{limit};
+        [[maybe_unused]] const auto warm = ProcessQueries(server, {"curly"s}, options);
+        const std::vector<std::string> repeated = {"curly"s, "nasty rat"s, "curly"s, "rat"s};
+        const auto limited_expected = ProcessQueries(server, repeated, options);
+        const JoinedDocuments limited = ProcessQueriesJoined(server, repeated, options);
+        ASSERT_EQUAL(limited.GetQueryCount(), repeated.size());
+        for (size_t i = 0; i < repeated.size(); ++i) {
+            ASSERT_EQUAL(limited[i].size(), limited_expected[i].size());
+            for (size_t j = 0; j < limited_expected[i].size(); ++j) {
+                ASSERT_EQUAL(limited[i][j].id, limited_expected[i][j].id);
+            }
+        }
+    }
+}
+
+void TestThreadPool() {
+    /*
+     * Пул потоков выполняет все итерации ParallelFor, в том числе вложенные, пробрасывает исключения,
+     * а параллельные пути сервера в пуле дают те же результаты, что и без него.
+     */
+    ThreadPool pool(3);
+    std::vector<std::atomic<int>> counters(100);
+    pool.ParallelFor(0, counters.size(), [&pool, &counters](size_t i) {
+        pool.ParallelFor(0, 10, [&counters, i](size_t) { ++counters[i]; });
+    });
+    ASSERT(std::all_of(counters.begin(), counters.end(), [](const std::atomic<int>& counter) { return counter == 10; }));
+    bool thrown = false;
+    try {
+        pool.ParallelFor(0, 50, [](size_t i) {
+            if (i == 42) {
+                throw std::out_of_range("42"s);
+            }
+        });
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    ASSERT(thrown);
+
+    //внешний поток сам выполняет свои части из общей очереди, пока единственный рабочий поток занят
+    {
+        std::promise<void> started;
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        ThreadPool single_pool(1);
+        single_pool.Submit([&started, released] {
+            started.set_value();
+            released.wait();
+        });
+        started.get_future().wait();
+        std::atomic<int> done = 0;
+        single_pool.ParallelFor(0, 8, [&done](size_t) {
+            ++done;
+        });
+        ASSERT_EQUAL(done.load(), 8);
+        release.set_value();
+    }
+    //закрепление идет только на доступные процессу процессоры и на Linux удается
+    {
+        ThreadPool pinned_pool(2, true);
+        std::atomic<int> done = 0;
+        pinned_pool.ParallelFor(0, 4, [&done](size_t) {
+            ++done;
+        });
+        ASSERT_EQUAL(done.load(), 4);
+    }
+
+    const std::vector<std::string> texts = {"funny pet and nasty rat"s, "funny pet with curly hair"s,
+                                            "nasty rat with curly hair"s, "pet with rat and rat and rat"s};
+    SearchServer reference("and with"s);
+    SearchServer server("and with"s);
+    server.EnableThreadPool(2);
+    std::vector<NewDocument> documents;
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        reference.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id});
+        documents.push_back({id, texts[id], DocumentStatus::ACTUAL, {id}});
+    }
+    server.AddDocuments(documents);
+    ASSERT_EQUAL(server.GetDocumentCount(), reference.GetDocumentCount());
+    documents = {{10, "new pet", DocumentStatus::ACTUAL, {}}, {11, "broken\x01pet", DocumentStatus::ACTUAL, {}}};
+    try {
+        server.AddDocuments(documents);
+    } catch (const std::invalid_argument&) {
+    }
+    ASSERT_EQUAL_HINT(server.GetDocumentCount(), 4, "Batch with an invalid document must not be added"s);
+
+    const std::vector<std::string> queries = {"nasty rat"s, "curly pet"s, "funny -rat"s};
+    const auto expected = ProcessQueries(reference, queries);
+    const auto results = ProcessQueries(server, queries);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        ASSERT_EQUAL(results[i].size(), expected[i].size());
+        const auto parallel = server.FindTopDocuments(std::execution::par, queries[i]);
+        ASSERT_EQUAL(parallel.size(), expected[i].size());
+        for (size_t j = 0; j < expected[i].size(); ++j) {
+            ASSERT_EQUAL(results[i][j].id, expected[i][j].id);
+            ASSERT_EQUAL(parallel[j].id, expected[i][j].id);
+        }
+    }
+    server.RemoveDocument(std::execution::par, 3);
+    reference.RemoveDocument(3);
+    ASSERT_EQUAL(server.FindTopDocuments("rat"s).size(), reference.FindTopDocuments("rat"s).size());
+}
+
+void TestAsyncQueries() {
+    /*
+     * Асинхронные запросы возвращают те же результаты, что и синхронные, в том числе
+     * при числе запросов больше длины очереди, и передают исключения через future.
+     */
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "nasty rat with curly hair"s, DocumentStatus::BANNED, {3});
+    bool thrown = false;
+    try {
+        [[maybe_unused]] auto future = server.SubmitFindTopDocuments("rat"s);
+    } catch (const std::logic_error&) {
+        thrown = true;
+    }
+    ASSERT_HINT(thrown, "Async queries are disabled by default"s);
+
+    server.EnableAsyncQueries(2, 4);
+    std::vector<std::future<std::vector<Document>>> futures;
+    for (int i = 0; i < 50; ++i) {
+        futures.push_back(server.SubmitFindTopDocuments(i % 2 == 0 ? "curly rat"s : "funny"s));
+    }
+    for (size_t i = 0; i < futures.size(); ++i) {
+        ASSERT_EQUAL(futures[i].get().size(), 2u);
+    }
+    ASSERT_EQUAL(server.SubmitFindTopDocuments("curly"s, DocumentStatus::BANNED).get().size(), 1u);
+    const auto [words, status] = server.SubmitMatchDocument("nasty rat -hair"s, 1).get();
+    ASSERT_EQUAL(words.size(), 2u);
+
+    auto invalid = server.SubmitFindTopDocuments("--rat"s);
+    thrown = false;
+    try {
+        invalid.get();
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT(thrown);
+
+    //задачи из потока исполнителя не ждут места в очереди: иначе единственный поток ждал бы сам себя
+    std::promise<int> nested_done;
+    AsyncExecutor executor(1, 1);
+    executor.Post([&executor, &nested_done] {
+        auto counter = std::make_shared<std::atomic<int>>(0);
+        for (int i = 0; i < 3; ++i) {
+            executor.Post([counter, &nested_done] {
+                if (++*counter == 3) {
+                    nested_done.set_value(3);
+                }
+            });
+        }
+    });
+    auto nested_future = nested_done.get_future();
+    ASSERT_HINT(nested_future.wait_for(std::chrono::seconds(10)) == std::future_status::ready,
+                "Tasks posted from a worker over queue capacity must not deadlock"s);
+    ASSERT_EQUAL(nested_future.get(), 3);
+
+    //TrySubmit не ждет места: при заполненной очереди задача не ставится
+    std::promise<void> worker_started;
+    std::promise<void> worker_released;
+    AsyncExecutor busy_executor(1, 1);
+    busy_executor.Post([&worker_started, released = worker_released.get_future().share()] {
+        worker_started.set_value();
+        released.wait();
+    });
+    worker_started.get_future().wait();
+    auto queued = busy_executor.TrySubmit([] {
+        return 1;
+    });
+    ASSERT(queued.has_value());
+    ASSERT_HINT(!busy_executor.TrySubmit([] {
+        return 2;
+    }).has_value(), "TrySubmit must not block on a full queue"s);
+    worker_released.set_value();
+    ASSERT_EQUAL(queued->get(), 1);
+
+    auto submitted = server.TrySubmitFindTopDocuments("curly rat"s);
+    ASSERT(submitted.has_value());
+    ASSERT_EQUAL(submitted->get().size(), 2u);
+}
+
+void TestQueryDeadline() {
+    /*
+     * Запрос с истекшим сроком или отмененным токеном прерывается: без allow_partial выбрасывается
+     * QueryInterruptedError, с ним возвращается неполный результат, который не попадает в кеш.
+     */
+    SearchServer server("and with"s);
+    for (int id = 0; id < 3000; ++id) {
+        server.AddDocument(id, id % 2 == 0 ? "funny pet and nasty rat"s : "curly rat with funny hair"s,
+                           DocumentStatus::ACTUAL, {id % 10});
+    }
+    server.EnableResultCache(16);
+
+    QueryStatus status = QueryStatus::CANCELLED;
+    QueryOptions options;
+    options.deadline = std::chrono::steady_clock::now() + std::chrono::hours(1);
+    options.status = &status;
+    ASSERT_EQUAL(server.FindTopDocuments("funny rat"s, options).size(), 5u);
+    ASSERT(status == QueryStatus::COMPLETE);
+
+    for (const bool impact_ordered : {false, true}) {
+        QueryOptions expired;
+        expired.deadline = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+        expired.impact_ordered = impact_ordered;
+        expired.status = &status;
+        bool thrown = false;
+        try {
+            [[maybe_unused]] const auto documents = server.FindTopDocuments("curly nasty"s, expired);
+        } catch (const QueryInterruptedError& error) {
+            thrown = error.GetStatus() == QueryStatus::DEADLINE_EXCEEDED;
+        }
+        ASSERT_HINT(thrown, "Expired deadline must interrupt the query"s);
+        ASSERT(status == QueryStatus::DEADLINE_EXCEEDED);
+
+        expired.allow_partial = true;
+        status = QueryStatus::COMPLETE;
+        ASSERT(server.FindTopDocuments(std::execution::par, "curly nasty"s, expired).size() <= 5u);
+        ASSERT(status == QueryStatus::DEADLINE_EXCEEDED);
+    }
+    ASSERT_EQUAL_HINT(server.GetResultCache()->GetStatistics().size, 1u, "Partial results must not be cached"s);
+
+    CancellationToken token;
+    QueryOptions cancelled;
+    cancelled.cancellation = token;
+    cancelled.allow_partial = true;
+    cancelled.status = &status;
+    token.Cancel();
+    [[maybe_unused]] const auto documents = server.FindTopDocuments("hair"s, cancelled);
+    ASSERT(status == QueryStatus::CANCELLED);
+
+    cancelled.allow_partial = false;
+    bool thrown = false;
+    try {
+        [[maybe_unused]] const auto results = ProcessQueries(server, {"funny"s, "curly"s}, cancelled);
+    } catch (const QueryInterruptedError& error) {
+        thrown = error.GetStatus() == QueryStatus::CANCELLED;
+    }
+    ASSERT(thrown);
+}
+
+void TestAdmissionControl() {
+    /*
+     * Запросы, не помещающиеся в бюджет, упрощаются, а не помещающиеся и упрощенными - отклоняются.
+     * Чтобы проверить допуск при уже выполняемом запросе, вложенные запросы выполняются из предиката внешнего.
+     */
+    SearchServer server("and with"s);
+    for (int id = 0; id < 90; ++id) {
+        server.AddDocument(id, id < 40 ? "cat"s : id < 60 ? "dog"s : "rat"s, DocumentStatus::ACTUAL, {id});
+    }
+    ASSERT_EQUAL(server.EstimateQueryCost("cat dog -rat"s), 90u);
+    ASSERT_EQUAL(server.EstimateQueryCost("unknown"s), 0u);
+
+    AdmissionPolicy policy;
+    policy.cost_budget = 100;
+    policy.expensive_cost = 30;
+    policy.expensive_load_share = 0.5;
+    policy.degraded_limit = 2;
+    policy.degraded_postings_budget = 20;
+    AdmissionController controller(server, policy);
+
+    size_t expensive_size = 0;
+    size_t cheap_size = 0;
+    bool inner_done = false;
+    [[maybe_unused]] const auto outer = controller.FindTopDocuments("cat dog"s, [&](int, DocumentStatus, int) {
+        if (!inner_done) {
+            inner_done = true;
+            //загрузка 60 + 40: дорогой запрос упрощается
+            expensive_size = controller.FindTopDocuments("cat"s).size();
+            //60 + 20 помещается в бюджет
+            cheap_size = controller.FindTopDocuments("dog"s).size();
+        }
+        return true;
+    });
+    ASSERT_EQUAL(expensive_size, 2u);
+    ASSERT_EQUAL(cheap_size, 5u);
+
+    bool rejected = false;
+    inner_done = false;
+    [[maybe_unused]] const auto overloaded = controller.FindTopDocuments("cat dog rat"s, [&](int, DocumentStatus, int) {
+        if (!inner_done) {
+            inner_done = true;
+            try {
+                [[maybe_unused]] const auto results = controller.ProcessQueries({"dog"s});
+            } catch (const QueryRejectedError&) {
+                rejected = true;
+            }
+        }
+        return true;
+    });
+    ASSERT_HINT(rejected, "Query exceeding the budget even when degraded must be rejected"s);
+
+    //бюджет постингов упрощения действует на каждый запрос пакета: упрощенный пакет стоит 20 за каждый дорогой запрос
+    std::vector<std::vector<Document>> degraded_batch;
+    rejected = false;
+    inner_done = false;
+    [[maybe_unused]] const auto with_batches = controller.FindTopDocuments("cat dog"s, [&](int, DocumentStatus, int) {
+        if (!inner_done) {
+            inner_done = true;
+            //60 + (20 + 20)
+            degraded_batch = controller.ProcessQueries({"cat"s, "rat"s});
+            try {
+                //60 + (20 + 20 + 20) не помещается, хотя min(90, 20) поместилось бы
+                [[maybe_unused]] const auto results = controller.ProcessQueries({"cat"s, "rat"s, "dog"s});
+            } catch (const QueryRejectedError&) {
+                rejected = true;
+            }
+        }
+        return true;
+    });
+    ASSERT_EQUAL(degraded_batch.size(), 2u);
+    ASSERT_EQUAL(degraded_batch[0].size(), 2u);
+    ASSERT_HINT(rejected, "Degraded batch must be charged the degraded cost of every query"s);
+
+    const AdmissionController::Statistics statistics = controller.GetStatistics();
+    ASSERT_EQUAL(statistics.admitted, 4u);
+    ASSERT_EQUAL(statistics.degraded, 2u);
+    ASSERT_EQUAL(statistics.rejected, 2u);
+    ASSERT_EQUAL(statistics.in_flight_cost, 0u);
+
+    //стоимость берется из того же разбора, по которому выполняется запрос: один разбор на запрос
+    const SearchServer::PreparedQuery prepared = server.PrepareQuery("cat dog -rat"s);
+    ASSERT_EQUAL(prepared.GetCost(), 90u);
+    ASSERT_EQUAL(server.FindTopDocuments(prepared).size(), server.FindTopDocuments("cat dog -rat"s).size());
+    StageTimings::Reset();
+    [[maybe_unused]] const auto single = controller.FindTopDocuments("cat"s);
+    [[maybe_unused]] const auto batch = controller.ProcessQueries({"cat"s, "dog"s});
+#if SEARCH_SERVER_STAGE_TIMINGS
+    ASSERT_EQUAL(StageTimings::GetSnapshot()[static_cast<size_t>(QueryStage::PARSE)].GetCount(), 3u);
+#endif
+}
+
+void TestRequestStatistics() {
+    /*
+     * Гистограмма ошибается не больше чем на 1/8; окна статистики сдвигаются по времени,
+     * а записи из нескольких потоков не теряются.
+     */
+    LatencyHistogram histogram;
+    for (uint64_t value = 1; value <= 1000; ++value) {
+        histogram.Record(value * 1000);
+    }
+    ASSERT_EQUAL(histogram.GetCount(), 1000u);
+    const uint64_t median = histogram.GetPercentile(0.5);
+    ASSERT(median >= 500'000 && median <= 500'000 + 500'000 / 8);
+    for (uint64_t value : {0ull, 7ull, 8ull, 1000ull, 123'456'789ull}) {
+        const size_t bucket = LatencyHistogram::GetBucket(value);
+        ASSERT(LatencyHistogram::GetBucketLowerBound(bucket) <= value);
+        ASSERT(value <= LatencyHistogram::GetBucketUpperBound(bucket));
+    }
+
+    using namespace std::chrono_literals;
+    const auto origin = RequestStatistics::Clock::now();
+    RequestStatistics statistics(4, origin);
+    statistics.Record(0, 2ms, origin);
+    statistics.Record(3, 4ms, origin + 10s);
+    auto minute = statistics.GetSummary(RequestStatistics::Window::MINUTE, origin + 10s);
+    ASSERT_EQUAL(minute.requests, 2u);
+    ASSERT_EQUAL(minute.no_result_requests, 1u);
+    ASSERT(minute.latency.GetPercentile(1.0) >= 4'000'000);
+
+    minute = statistics.GetSummary(RequestStatistics::Window::MINUTE, origin + 65s);
+    ASSERT_EQUAL_HINT(minute.requests, 1u, "Requests older than a minute must leave the minute window"s);
+    statistics.Record(0, 1ms, origin + 2h);
+    ASSERT_EQUAL(statistics.GetSummary(RequestStatistics::Window::HOUR, origin + 2h).requests, 1u);
+    ASSERT_EQUAL(statistics.GetSummary(RequestStatistics::Window::DAY, origin + 2h).requests, 3u);
+    ASSERT_EQUAL(statistics.GetSummary(RequestStatistics::Window::DAY, origin + 2h).no_result_requests, 2u);
+    const auto total = statistics.GetSummary(RequestStatistics::Window::TOTAL, origin + 48h);
+    ASSERT_EQUAL_HINT(total.requests, 3u, "The total window must never drop requests"s);
+    ASSERT_EQUAL(total.no_result_requests, 2u);
+
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {1});
+    RequestQueue queue(server);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&queue] {
+            for (int i = 0; i < 250; ++i) {
+                [[maybe_unused]] const auto documents = queue.AddFindRequest(i % 2 == 0 ? "rat"s : "cat"s);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const auto summary = queue.GetStatistics(RequestStatistics::Window::MINUTE);
+    ASSERT_EQUAL(summary.requests, 1000u);
+    ASSERT_EQUAL(summary.latency.GetCount(), 1000u);
+    ASSERT_EQUAL(queue.GetNoResultRequests(), 500);
+}
+
+void TestStageTimings() {
+    /*
+     * Каждая стадия запроса попадает в свою гистограмму, в том числе при выполнении
+     * в нескольких потоках; без SEARCH_SERVER_STAGE_TIMINGS ничего не записывается.
+     */
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {2});
+    StageTimings::Reset();
+    [[maybe_unused]] const auto documents = server.FindTopDocuments("funny -rat"s);
+    [[maybe_unused]] const auto parallel_documents = server.FindTopDocuments(std::execution::par, "curly pet"s);
+    [[maybe_unused]] const auto results = ProcessQueries(server, {"funny"s, "nasty -curly"s});
+    const StageTimings::Snapshot snapshot = StageTimings::GetSnapshot();
+    const auto count = [&snapshot](QueryStage stage) {
+        return snapshot[static_cast<size_t>(stage)].GetCount();
+    };
+#if SEARCH_SERVER_STAGE_TIMINGS
+    ASSERT_EQUAL(count(QueryStage::PARSE), 4u);
+    ASSERT(count(QueryStage::LOOKUP) >= 3u);
+    ASSERT(count(QueryStage::MINUS_FILTER) >= 2u);
+    ASSERT(count(QueryStage::SCORE) >= 4u);
+    ASSERT(count(QueryStage::SELECT) >= 4u);
+#else
+    ASSERT_EQUAL(count(QueryStage::PARSE), 0u);
+#endif
+    ASSERT_EQUAL(StageTimings::GetStageName(QueryStage::MINUS_FILTER), "minus_filter"s);
+}
+
+void TestTrace() {
+    /*
+     * Между Trace::Start и Trace::Stop области TRACE_SCOPE и LOG_DURATION попадают в трассу,
+     * в том числе из параллельных задач; после Stop события не добавляются.
+     * События завершившихся потоков освобождаются после записи трассы.
+     */
+    SearchServer server("and with"s);
+    Trace::Start();
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {2});
+    [[maybe_unused]] const auto documents = server.FindTopDocuments(std::execution::par, "curly pet"s);
+    [[maybe_unused]] const auto results = ProcessQueries(server, {"funny"s, "nasty"s});
+    std::ostringstream log;
+    {
+        LOG_DURATION_STREAM("quoted \"scope\""s, log);
+    }
+    std::thread([] {
+        const Trace::Clock::time_point now = Trace::Clock::now();
+        Trace::AddEvent("finished thread", now, now);
+    }).join();
+    Trace::Stop();
+    const size_t event_count = Trace::GetEventCount();
+    [[maybe_unused]] const auto untraced = server.FindTopDocuments("funny"s);
+    ASSERT_EQUAL(Trace::GetEventCount(), event_count);
+
+    std::ostringstream output;
+    Trace::WriteChromeTrace(output);
+    const std::string trace = output.str();
+#if SEARCH_SERVER_TRACING
+    for (const std::string& name : {"\"AddDocument\""s, "\"FindTopDocuments\""s, "\"ScoreUnit\""s,
+                                    "\"BatchQuery\""s, "\"quoted \\\"scope\\\"\""s}) {
+        ASSERT_HINT(trace.find(name) != std::string::npos, name);
+    }
+#endif
+    ASSERT(trace.find("\"traceEvents\":["s) != std::string::npos);
+    ASSERT(trace.find("\"finished thread\""s) != std::string::npos);
+    //буфер завершившегося потока освобождается после записи
+    ASSERT_EQUAL(Trace::GetEventCount(), event_count - 1);
+    ASSERT_EQUAL(Trace::GetDroppedCount(), 0u);
+    Trace::Clear();
+    ASSERT_EQUAL(Trace::GetEventCount(), 0u);
+}
+
+void TestPerfCounters() {
+    /*
+     * Если система разрешает perf_event_open, стадии запросов и добавления документов получают
+     * приращения счетчиков; иначе профилирование не включается и отчет остается пустым.
+     */
+    PerfCounters::Reset();
+    const bool enabled = PerfCounters::Enable();
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {2});
+    const auto before = PerfCounters::ReadThread();
+    [[maybe_unused]] const auto documents = server.FindTopDocuments("funny -rat"s);
+    const auto after = PerfCounters::ReadThread();
+    PerfCounters::Disable();
+
+    const PerfCounters::Report report = PerfCounters::GetReport();
+    const auto& score = report[static_cast<size_t>(QueryStage::SCORE)];
+    //разность ReadThread не зависит от STAGE_TIMER и работает в любой сборке
+    if (enabled) {
+        ASSERT(before && after && (*after - *before).instructions > 0);
+    }
+#if SEARCH_SERVER_STAGE_TIMINGS
+    if (enabled) {
+        ASSERT_EQUAL(report[static_cast<size_t>(QueryStage::INGEST)].samples, 2u);
+        ASSERT_EQUAL(score.samples, 1u);
+        ASSERT(score.values.instructions > 0);
+    }
+#endif
+    if (!enabled) {
+        ASSERT_EQUAL(score.samples, 0u);
+    }
+    std::ostringstream output;
+    PerfCounters::PrintReport(output);
+    ASSERT(output.str().find("minus_filter"s) != std::string::npos);
+}
+
+void TestAllocationCounter() {
+    /*
+     * В сборке с SEARCH_SERVER_COUNT_ALLOCATIONS каждая операция сервера учитывает свои выделения;
+     * без нее отчет остается пустым.
+     */
+    AllocationCounter::Reset();
+    const AllocationCounts before = AllocationCounter::ReadThread();
+    //прямой вызов operator new, в отличие от new-выражения, компилятор не убирает
+    void* memory = ::operator new(128);
+    ::operator delete(memory);
+    const AllocationCounts delta = AllocationCounter::ReadThread() - before;
+
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {2});
+    [[maybe_unused]] const auto documents = server.FindTopDocuments("funny -rat"s);
+    [[maybe_unused]] const auto match = server.MatchDocument("curly pet"s, 2);
+    server.RemoveDocument(1);
+
+    const AllocationCounter::Report report = AllocationCounter::GetReport();
+    const auto& add = report[static_cast<size_t>(AllocatingOperation::ADD_DOCUMENT)];
+    if (AllocationCounter::IsEnabled()) {
+        ASSERT_EQUAL(delta.allocations, 1u);
+        ASSERT_EQUAL(delta.deallocations, 1u);
+        ASSERT_EQUAL(delta.bytes, 128u);
+        ASSERT_EQUAL(add.calls, 2u);
+        ASSERT(add.counts.allocations > 0 && add.counts.bytes > 0);
+        for (const auto operation : {AllocatingOperation::FIND_TOP_DOCUMENTS, AllocatingOperation::MATCH_DOCUMENT,
+                                     AllocatingOperation::REMOVE_DOCUMENT}) {
+            ASSERT_EQUAL(report[static_cast<size_t>(operation)].calls, 1u);
+        }
+    } else {
+        ASSERT_EQUAL(delta.allocations, 0u);
+        ASSERT_EQUAL(add.calls, 0u);
+    }
+    std::ostringstream output;
+    AllocationCounter::PrintReport(output);
+    ASSERT(output.str().find("RemoveDocument"s) != std::string::npos);
+}
+
+void TestExplainQuery() {
+    /*
+     * Объяснение запроса дает те же документы и релевантности, что FindTopDocuments,
+     * раскладывает релевантность по словам и считает просмотренные постинги.
+     */
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7});
+    server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "curly dog"s, DocumentStatus::BANNED, {4});
+    server.AddDocument(4, "big cat"s, DocumentStatus::ACTUAL, {1});
+
+    const QueryExplanation explanation = server.ExplainQuery("funny curly pet -rat"s);
+    ASSERT_EQUAL(explanation.terms.size(), 4u);
+    const auto& minus_term = explanation.terms.back();
+    ASSERT(minus_term.is_minus && minus_term.word == "rat"s && minus_term.posting_count == 1);
+    const auto& curly = explanation.terms[0];
+    ASSERT_EQUAL(curly.word, "curly"s);
+    ASSERT_EQUAL(curly.posting_count, 2u);
+    ASSERT(std::abs(curly.inverse_document_freq - std::log(2.0)) < 1e-9);
+
+    //funny и pet - по два постинга, curly - два, из них один у документа 1 с минус-словом
+    ASSERT_EQUAL(explanation.work.postings_scanned, 6u);
+    ASSERT_EQUAL(explanation.work.minus_exclusions, 2u);
+    ASSERT_EQUAL(explanation.work.predicate_evaluations, 4u);
+    ASSERT_EQUAL(explanation.work.excluded_documents, 1u);
+    ASSERT_EQUAL(explanation.work.candidate_documents, 1u);
+
+    const std::vector<Document> documents = server.FindTopDocuments("funny curly pet -rat"s);
+    ASSERT_EQUAL(explanation.top_documents.size(), documents.size());
+    const auto& top = explanation.top_documents.front();
+    ASSERT_EQUAL(top.document.id, documents.front().id);
+    ASSERT_EQUAL(top.contributions.size(), 3u);
+    double relevance = 0.0;
+    for (const auto& contribution : top.contributions) {
+        relevance += contribution.relevance;
+    }
+    ASSERT(std::abs(relevance - documents.front().relevance) < 1e-9);
+
+    ASSERT_EQUAL(server.ExplainQuery("curly"s, DocumentStatus::BANNED).top_documents.front().document.id, 3);
+    std::ostringstream output;
+    output << explanation;
+    ASSERT(output.str().find("postings_scanned = 6"s) != std::string::npos);
+
+    //объяснение идет тем же путем, что FindTopDocuments, но его стадии не попадают в StageTimings
+    const auto count_stage_records = [] {
+        uint64_t count = 0;
+        for (const LatencyHistogram& histogram : StageTimings::GetSnapshot()) {
+            count += histogram.GetCount();
+        }
+        return count;
+    };
+    server.EnablePairPostingCache(1 << 20, 1);
+    server.EnableResultCache(100);
+    QueryOptions impact_options;
+    impact_options.impact_ordered = true;
+    const uint64_t records_before = count_stage_records();
+    const QueryExplanation paired = server.ExplainQuery("funny pet -rat"s);
+    const QueryExplanation by_impact = server.ExplainQuery("funny curly pet -rat"s, impact_options);
+    ASSERT_EQUAL(count_stage_records(), records_before);
+
+    //funny и pet посчитаны одной парой: ее постинги - документы 1 и 2
+    ASSERT_EQUAL(paired.work.pair_units, 1u);
+    ASSERT_EQUAL(paired.work.postings_scanned, 2u);
+    ASSERT_EQUAL(paired.work.minus_exclusions, 1u);
+    ASSERT(!paired.result_cached);
+    ASSERT_EQUAL(server.GetResultCache()->GetStatistics().size, 0u);
+    [[maybe_unused]] const auto cached_documents = server.FindTopDocuments("funny pet -rat"s);
+    ASSERT(server.ExplainQuery("funny pet -rat"s).result_cached);
+
+    //при обходе по вкладу минус-слова и фильтр проверяются один раз на документ
+    ASSERT_EQUAL(by_impact.work.minus_exclusions, 1u);
+    ASSERT_EQUAL(by_impact.work.predicate_evaluations, 2u);
+    ASSERT_EQUAL(by_impact.top_documents.size(), 1u);
+    ASSERT_EQUAL(by_impact.top_documents.front().document.id, documents.front().id);
+}
+
+void TestIndexStatistics() {
+    /*
+     * Сводка по индексу: словарь и длины постингов считаются по текущему индексу,
+     * попадания стоп-слов копятся по всем добавленным документам.
+     */
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7});
+    server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "curly dog"s, DocumentStatus::BANNED, {4});
+    server.AddDocument(4, "big cat"s, DocumentStatus::IRRELEVANT, {1});
+    const std::vector<NewDocument> documents = {{5, std::string_view("funny and funny"), DocumentStatus::ACTUAL, {1}}};
+    server.AddDocuments(documents);
+
+    const IndexStatistics statistics = server.GetIndexStatistics(2);
+    ASSERT_EQUAL(statistics.document_count, 5u);
+    ASSERT_EQUAL(statistics.vocabulary_size, 9u);
+    ASSERT_EQUAL(statistics.total_postings, 13u);
+    ASSERT(std::abs(statistics.average_unique_terms_per_document - 2.6) < 1e-9);
+    ASSERT_EQUAL(statistics.posting_lengths.min, 1u);
+    ASSERT_EQUAL(statistics.posting_lengths.p50, 1u);
+    ASSERT_EQUAL(statistics.posting_lengths.p90, 2u);
+    ASSERT_EQUAL(statistics.posting_lengths.max, 3u);
+    ASSERT_EQUAL(statistics.posting_length_histogram, (std::vector<size_t>{6, 3}));
+    ASSERT_EQUAL(statistics.longest_postings.size(), 2u);
+    ASSERT(statistics.longest_postings[0] == std::pair("funny"s, size_t{3}));
+    ASSERT(statistics.longest_postings[1] == std::pair("curly"s, size_t{2}));
+    ASSERT_EQUAL(statistics.status_document_counts[static_cast<size_t>(DocumentStatus::ACTUAL)], 3u);
+    ASSERT_EQUAL(statistics.status_document_counts[static_cast<size_t>(DocumentStatus::BANNED)], 1u);
+    ASSERT_EQUAL(statistics.status_document_counts[static_cast<size_t>(DocumentStatus::IRRELEVANT)], 1u);
+    ASSERT_EQUAL(statistics.ingested_words, 17u);
+    ASSERT_EQUAL(statistics.stop_word_hits, 3u);
+    ASSERT(std::abs(statistics.stop_word_hit_rate - 3.0 / 17.0) < 1e-9);
+    ASSERT(statistics.stop_word_counts.front() == std::pair("and"s, uint64_t{2}));
+
+    //слова с опустевшими постингами не входят в словарь
+    server.RemoveDocument(3);
+    const IndexStatistics after_remove = server.GetIndexStatistics();
+    ASSERT_EQUAL(after_remove.vocabulary_size, 8u);
+    ASSERT_EQUAL(after_remove.status_document_counts[static_cast<size_t>(DocumentStatus::BANNED)], 0u);
+    ASSERT_EQUAL(after_remove.ingested_words, 17u);
+
+    std::ostringstream output;
+    output << statistics;
+    ASSERT(output.str().find("vocabulary = 9"s) != std::string::npos);
+}
+
+void TestMetricsRegistry() {
+    /*
+     * Реестр выводит счетчики, значения функций и гистограммы в текстовом формате Prometheus
+     * и отвергает недопустимые имена и повторную регистрацию ряда.
+     */
+    MetricsRegistry registry;
+    MetricsRegistry::Counter& counter = registry.AddCounter("test_events_total"s, "Events."s, {{"kind"s, "a\"b"s}});
+    counter.Increment(3);
+    registry.AddGauge("test_ratio"s, "Ratio."s, [] {
+        return 0.25;
+    });
+    registry.AddHistogram("test_duration_seconds"s, "Durations."s, [] {
+        LatencyHistogram histogram;
+        histogram.Record(std::chrono::microseconds(300));
+        histogram.Record(std::chrono::milliseconds(3));
+        return histogram;
+    });
+    const std::string text = registry.RenderText();
+    ASSERT(text.find("# TYPE test_events_total counter\ntest_events_total{kind=\"a\\\"b\"} 3\n"s) != std::string::npos);
+    ASSERT(text.find("test_ratio 0.25\n"s) != std::string::npos);
+    ASSERT(text.find("test_duration_seconds_bucket{le=\"0.0001\"} 0\n"s) != std::string::npos);
+    ASSERT(text.find("test_duration_seconds_bucket{le=\"0.0005\"} 1\n"s) != std::string::npos);
+    ASSERT(text.find("test_duration_seconds_bucket{le=\"+Inf\"} 2\n"s) != std::string::npos);
+    ASSERT(text.find("test_duration_seconds_count 2\n"s) != std::string::npos);
+
+    //ряды группы берут гистограммы из одного вызова функции на вывод
+    MetricsRegistry group_registry;
+    int group_calls = 0;
+    size_t group_size = 2;
+    group_registry.AddHistograms("test_stage_seconds"s, "Stages."s, [&group_calls, &group_size] {
+        ++group_calls;
+        std::vector<LatencyHistogram> histograms(group_size);
+        if (!histograms.empty()) {
+            histograms.back().Record(std::chrono::milliseconds(3));
+        }
+        return histograms;
+    }, {{{"stage"s, "a"s}}, {{"stage"s, "b"s}}});
+    const std::string group_text = group_registry.RenderText();
+    ASSERT_EQUAL(group_calls, 1);
+    ASSERT(group_text.find("test_stage_seconds_count{stage=\"a\"} 0\n"s) != std::string::npos);
+    ASSERT(group_text.find("test_stage_seconds_count{stage=\"b\"} 1\n"s) != std::string::npos);
+    group_size = 1;
+    bool thrown = false;
+    try {
+        [[maybe_unused]] const std::string short_text = group_registry.RenderText();
+    } catch (const std::logic_error&) {
+        thrown = true;
+    }
+    ASSERT(thrown);
+
+    const auto throws = [&registry](const std::function<void()>& add) {
+        try {
+            add();
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    ASSERT(throws([&registry] { registry.AddCounter("1bad"s, "Bad."s); }));
+    ASSERT(throws([&registry] { registry.AddCounter("test_events_total"s, "Events."s, {{"kind"s, "a\"b"s}}); }));
+    ASSERT(throws([&registry] { registry.AddGauge("test_events_total"s, "Events."s, [] { return 1.0; }); }));
+
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {2});
+    server.EnableResultCache(16);
+    RequestQueue queue(server);
+    [[maybe_unused]] const auto found = queue.AddFindRequest("funny"s);
+    [[maybe_unused]] const auto cached = queue.AddFindRequest("funny"s);
+    [[maybe_unused]] const auto empty = queue.AddFindRequest("cat"s);
+
+    MetricsRegistry server_registry;
+    RegisterSearchServerMetrics(server_registry, server);
+    RegisterRequestQueueMetrics(server_registry, queue);
+    RegisterStageTimingMetrics(server_registry);
+    const std::string server_text = server_registry.RenderText();
+    ASSERT(server_text.find("search_server_documents 2\n"s) != std::string::npos);
+    ASSERT(server_text.find("search_server_ingested_documents_total 2\n"s) != std::string::npos);
+    ASSERT(server_text.find("search_server_ingested_words_total 10\n"s) != std::string::npos);
+    ASSERT(server_text.find("search_server_result_cache_hits_total 1\n"s) != std::string::npos);
+    ASSERT(server_text.find("search_server_requests_total 3\n"s) != std::string::npos);
+    ASSERT(server_text.find("search_server_no_result_requests_total 1\n"s) != std::string::npos);
+    ASSERT(server_text.find("search_server_request_duration_seconds_count 3\n"s) != std::string::npos);
+    ASSERT(server_text.find("search_server_stage_duration_seconds_bucket{stage=\"ingest\",le=\"+Inf\"}"s)
+           != std::string::npos);
+    ASSERT(server.GetIndexMemoryUsage() > 0);
+}
+
 // Функция TestSearchServer является точкой входа для запуска тестов
 [[maybe_unused]] void TestSearchServer() {
     RUN_TEST(TestAddedDocumentMustBeFind);
@@ -278,5 +1516,29 @@ void TestRelevanceCalc() {
     RUN_TEST(TestFilterByPredicate);
     RUN_TEST(TestFindByStatus);
     RUN_TEST(TestRelevanceCalc);
+    RUN_TEST(TestResultLimit);
+    RUN_TEST(TestImpactOrderedSearch);
+    RUN_TEST(TestDocumentBitmap);
+    RUN_TEST(TestFindByStatusAfterRemove);
+    RUN_TEST(TestFilterByDocumentFilter);
+    RUN_TEST(TestResultCache);
+    RUN_TEST(TestPairPostingCache);
+    RUN_TEST(TestLongQuery);
+    RUN_TEST(TestTokenizer);
+    RUN_TEST(TestCaseFolding);
+    RUN_TEST(TestProcessQueriesBatch);
+    RUN_TEST(TestProcessQueriesJoined);
+    RUN_TEST(TestThreadPool);
+    RUN_TEST(TestAsyncQueries);
+    RUN_TEST(TestQueryDeadline);
+    RUN_TEST(TestAdmissionControl);
+    RUN_TEST(TestRequestStatistics);
+    RUN_TEST(TestStageTimings);
+    RUN_TEST(TestTrace);
+    RUN_TEST(TestPerfCounters);
+    RUN_TEST(TestAllocationCounter);
+    RUN_TEST(TestExplainQuery);
+    RUN_TEST(TestIndexStatistics);
+    RUN_TEST(TestMetricsRegistry);
 }
 // --------- Окончание модульных тестов поисковой системы -----------
\ No newline at end of file
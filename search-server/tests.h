@@ -31,6 +31,30 @@ void TestRatingCalculation();
 void TestFilterByPredicate();
 void TestFindByStatus();
 void TestRelevanceCalc();
+void TestResultLimit();
+void TestImpactOrderedSearch();
+void TestDocumentBitmap();
+void TestFindByStatusAfterRemove();
+void TestFilterByDocumentFilter();
+void TestResultCache();
+void TestPairPostingCache();
+void TestLongQuery();
+void TestTokenizer();
+void TestCaseFolding();
+void TestProcessQueriesBatch();
+void TestProcessQueriesJoined();
+void TestThreadPool();
+void TestAsyncQueries();
+void TestQueryDeadline();
+void TestAdmissionControl();
+void TestRequestStatistics();
+void TestStageTimings();
+void TestTrace();
+void TestPerfCounters();
+void TestAllocationCounter();
+void TestExplainQuery();
+void TestIndexStatistics();
+void TestMetricsRegistry();
 
 template <typename T>
 void RunTestImpl(T& func, const std::string& name);
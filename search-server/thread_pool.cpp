@@ -0,0 +1,161 @@
+#include "thread_pool.h"
+
+#include <stdexcept>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+using namespace std::literals;
+
+namespace {
+//пул и номер рабочего потока, в котором выполняется код
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+#if defined(__linux__)
+//процессоры, на которых процессу разрешено выполняться (cpuset, taskset, ограничения cgroup)
+std::vector<int> GetAllowedCpus() {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+        throw std::runtime_error("Не удалось получить процессоры, доступные процессу: "s + std::strerror(errno));
+    }
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &cpu_set)) {
+            cpus.push_back(cpu);
+        }
+    }
+    if (cpus.empty()) {
+        throw std::runtime_error("Процессу не доступен ни один процессор"s);
+    }
+    return cpus;
+}
+#endif
+}  // namespace
+
+ThreadPool::ThreadPool(size_t worker_count, [[maybe_unused]] bool pin_threads)
+        : worker_count_(std::max<size_t>(worker_count, 1)) {
+    for (size_t i = 0; i <= worker_count_; ++i) {
+        queues_.push_back(std::make_unique<TaskQueue>());
+    }
+#if defined(__linux__)
+    const std::vector<int> cpus = pin_threads ? GetAllowedCpus() : std::vector<int>{};
+#endif
+    workers_.reserve(worker_count_);
+    for (size_t i = 0; i < worker_count_; ++i) {
+        workers_.emplace_back([this, i] {
+            RunWorker(i);
+        });
+    }
+#if defined(__linux__)
+    if (!pin_threads) {
+        return;
+    }
+    for (size_t i = 0; i < worker_count_; ++i) {
+        const int cpu = cpus[i % cpus.size()];
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu, &cpu_set);
+        const int error = pthread_setaffinity_np(workers_[i].native_handle(), sizeof(cpu_set), &cpu_set);
+        if (error != 0) {
+            //деструктор для недостроенного объекта не вызывается, потоки останавливаем сами
+            StopWorkers();
+            throw std::runtime_error("Не удалось закрепить рабочий поток "s + std::to_string(i) + " за процессором "s
+                                     + std::to_string(cpu) + ": "s + std::strerror(error));
+        }
+    }
+#endif
+}
+
+ThreadPool::~ThreadPool() {
+    StopWorkers();
+}
+
+size_t ThreadPool::GetWorkerCount() const {
+    return worker_count_;
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    {
+        //счетчик растет до появления задачи в очереди, чтобы не уйти в минус, когда ее сразу заберут;
+        //под мьютексом, чтобы засыпающий поток не пропустил новую задачу
+        std::lock_guard guard(sleep_mutex_);
+        queued_.fetch_add(1);
+    }
+    TaskQueue& queue = *queues_[GetCurrentWorker()];
+    {
+        std::lock_guard guard(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+size_t ThreadPool::GetCurrentWorker() const {
+    return current_pool == this ? current_worker : worker_count_;
+}
+
+bool ThreadPool::RunPendingTask(size_t self) {
+    std::function<void()> task;
+    const auto take = [this, &task](size_t index, bool from_back) {
+        TaskQueue& queue = *queues_[index];
+        std::lock_guard guard(queue.mutex);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        if (from_back) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        return true;
+    };
+
+    //рабочий поток берет свою последнюю задачу, внешний - первую из общей очереди, куда ставит свои
+    bool found = take(self, self < worker_count_);
+    for (size_t shift = 0; !found && shift < queues_.size(); ++shift) {
+        const size_t index = (self + 1 + shift) % queues_.size();
+        found = index != self && take(index, false);
+    }
+    if (!found) {
+        return false;
+    }
+    queued_.fetch_sub(1);
+    task();
+    return true;
+}
+
+void ThreadPool::StopWorkers() {
+    {
+        std::lock_guard guard(sleep_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::RunWorker(size_t index) {
+    current_pool = this;
+    current_worker = index;
+    while (true) {
+        if (RunPendingTask(index)) {
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        wake_.wait(lock, [this] {
+            return stop_ || queued_.load() > 0;
+        });
+        if (stop_ && queued_.load() == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Пул потоков с перехватом работы (work stealing). У каждого рабочего потока своя очередь:
+ * задачи, поставленные из рабочего потока, попадают в его очередь и выполняются им же с конца,
+ * а простаивающие потоки забирают задачи из начала чужих очередей. Задачи из внешних потоков
+ * попадают в общую очередь.
+ *
+ * Поток, ждущий завершения ParallelFor, сам выполняет задачи, поэтому вложенный ParallelFor
+ * внутри задачи не создает новых потоков и не блокирует рабочий поток.
+ */
+class ThreadPool {
+public:
+    /* pin_threads - закрепить i-й рабочий поток за i-м из процессоров, доступных процессу (только Linux).
+     * Если закрепить не удалось, выбрасывает std::runtime_error
+     */
+    explicit ThreadPool(size_t worker_count, bool pin_threads = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    [[nodiscard]] size_t GetWorkerCount() const;
+
+    void Submit(std::function<void()> task);
+
+    /*
+     * Вызывает func(i) для каждого i из [begin, end) и дожидается всех вызовов. Диапазон делится
+     * на части по числу рабочих потоков; первую часть выполняет вызывающий поток. Исключение,
+     * выброшенное func, пробрасывается вызывающему после завершения остальных частей.
+     */
+    template <typename Func>
+    void ParallelFor(size_t begin, size_t end, Func func);
+
+private:
+    //частей ParallelFor на рабочий поток: запас на неравномерные части
+    static constexpr size_t CHUNKS_PER_WORKER = 4;
+
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    //задается до запуска потоков: workers_ в это время еще заполняется
+    size_t worker_count_;
+    //очереди рабочих потоков, последняя - общая очередь для задач из внешних потоков
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> queued_ = 0;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+
+    //номер рабочего потока этого пула, выполняющего текущий код, либо число рабочих потоков для внешнего потока
+    [[nodiscard]] size_t GetCurrentWorker() const;
+    //выполняет одну задачу: свою последнюю, иначе первую из общей или чужой очереди; false, если задач нет
+    bool RunPendingTask(size_t self);
+    void RunWorker(size_t index);
+    void StopWorkers();
+};
+
+template <typename Func>
+void ThreadPool::ParallelFor(size_t begin, size_t end, Func func) {
+    if (begin >= end) {
+        return;
+    }
+    const size_t count = end - begin;
+    const size_t chunk_count = std::min(count, worker_count_ * CHUNKS_PER_WORKER);
+    const size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+
+    struct State {
+        std::atomic<size_t> remaining = 0;
+        std::mutex mutex;
+        std::exception_ptr error;
+    } state;
+    const auto run_chunk = [&state, &func](size_t first, size_t last) {
+        try {
+            for (size_t i = first; i < last; ++i) {
+                func(i);
+            }
+        } catch (...) {
+            std::lock_guard guard(state.mutex);
+            if (!state.error) {
+                state.error = std::current_exception();
+            }
+        }
+    };
+
+    for (size_t first = begin + chunk_size; first < end; first += chunk_size) {
+        const size_t last = std::min(first + chunk_size, end);
+        state.remaining.fetch_add(1, std::memory_order_relaxed);
+        Submit([&state, &run_chunk, first, last] {
+            run_chunk(first, last);
+            state.remaining.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    run_chunk(begin, std::min(begin + chunk_size, end));
+
+    //пока части выполняются, помогаем пулу, а не ждем
+    const size_t self = GetCurrentWorker();
+    while (state.remaining.load(std::memory_order_acquire) != 0) {
+        if (!RunPendingTask(self)) {
+            std::this_thread::yield();
+        }
+    }
+    if (state.error) {
+        std::rethrow_exception(state.error);
+    }
+}
@@ -0,0 +1,101 @@
+#include "tokenizer.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+Tokenizer::CharClassTable Tokenizer::DefaultTable() {
+    CharClassTable table;
+    table.fill(CharClass::WORD);
+    for (int c = 0; c < ' '; ++c) {
+        table[c] = CharClass::INVALID;
+    }
+    table[static_cast<uint8_t>(' ')] = CharClass::DELIMITER;
+    return table;
+}
+
+Tokenizer::CharClassTable Tokenizer::DefaultTableWithDelimiters(std::string_view delimiters) {
+    CharClassTable table = DefaultTable();
+    for (const char c : delimiters) {
+        table[static_cast<uint8_t>(c)] = CharClass::DELIMITER;
+    }
+    return table;
+}
+
+Tokenizer::Tokenizer(const CharClassTable& table)
+        : table_(table)
+        , find_special_(FindSpecialScalar) {
+    for (size_t c = 0; c < table_.size(); ++c) {
+        if (table_[c] != CharClass::WORD) {
+            max_special_ = static_cast<uint8_t>(c);
+        }
+    }
+#if defined(__x86_64__)
+    //SSE2 есть на любом x86-64, AVX2 выбирается во время выполнения
+    find_special_ = __builtin_cpu_supports("avx2") ? FindSpecialAvx2 : FindSpecialSse2;
+#endif
+}
+
+size_t Tokenizer::FindInvalid(std::string_view text) const {
+    for (size_t pos = FindSpecial(text, 0); pos < text.size(); pos = FindSpecial(text, pos + 1)) {
+        if (table_[static_cast<uint8_t>(text[pos])] == CharClass::INVALID) {
+            return pos;
+        }
+    }
+    return std::string_view::npos;
+}
+
+const Tokenizer::CharClassTable& Tokenizer::GetTable() const {
+    return table_;
+}
+
+size_t Tokenizer::FindSpecial(std::string_view text, size_t pos) const {
+    return find_special_(*this, text, pos);
+}
+
+size_t Tokenizer::FindSpecialScalar(const Tokenizer& tokenizer, std::string_view text, size_t pos) {
+    while (pos < text.size() && tokenizer.table_[static_cast<uint8_t>(text[pos])] == CharClass::WORD) {
+        ++pos;
+    }
+    return pos;
+}
+
+#if defined(__x86_64__)
+size_t Tokenizer::FindSpecialSse2(const Tokenizer& tokenizer, std::string_view text, size_t pos) {
+    const __m128i threshold = _mm_set1_epi8(static_cast<char>(tokenizer.max_special_));
+    while (pos + 16 <= text.size()) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+        //байт - кандидат, если min(байт, порог) == байт, то есть байт не больше порога
+        auto candidates = static_cast<uint32_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(bytes, threshold), bytes)));
+        while (candidates != 0) {
+            const size_t candidate = pos + __builtin_ctz(candidates);
+            if (tokenizer.table_[static_cast<uint8_t>(text[candidate])] != CharClass::WORD) {
+                return candidate;
+            }
+            candidates &= candidates - 1;
+        }
+        pos += 16;
+    }
+    return FindSpecialScalar(tokenizer, text, pos);
+}
+
+__attribute__((target("avx2")))
+size_t Tokenizer::FindSpecialAvx2(const Tokenizer& tokenizer, std::string_view text, size_t pos) {
+    const __m256i threshold = _mm256_set1_epi8(static_cast<char>(tokenizer.max_special_));
+    while (pos + 32 <= text.size()) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + pos));
+        auto candidates = static_cast<uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(bytes, threshold), bytes)));
+        while (candidates != 0) {
+            const size_t candidate = pos + __builtin_ctz(candidates);
+            if (tokenizer.table_[static_cast<uint8_t>(text[candidate])] != CharClass::WORD) {
+                return candidate;
+            }
+            candidates &= candidates - 1;
+        }
+        pos += 32;
+    }
+    return FindSpecialSse2(tokenizer, text, pos);
+}
+#endif
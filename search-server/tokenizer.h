@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/*
+ * Разбиение текста на слова по таблице классов символов: каждый из 256 байтов - часть слова,
+ * разделитель или недопустимый символ. За один проход текст делится на слова и проверяется
+ * на недопустимые символы. Байты, не относящиеся к словам, ищутся блоками по 32 (AVX2) или 16 (SSE2) байт,
+ * на остальных платформах - побайтово.
+ *
+ * Блоковый поиск отбирает кандидатов - байты не больше наибольшего байта, не относящегося к словам,
+ * и проверяет их по таблице. По умолчанию это пробел и управляющие символы, и кандидатов в обычном
+ * тексте мало; таблица с разделителями-знаками пунктуации делает кандидатами и латинские буквы.
+ */
+class Tokenizer {
+public:
+    enum class CharClass : uint8_t {
+        WORD,
+        DELIMITER,
+        INVALID,
+    };
+    using CharClassTable = std::array<CharClass, 256>;
+
+    // разделитель - пробел, символы с кодами от 0 до 31 недопустимы
+    static CharClassTable DefaultTable();
+    // таблица по умолчанию, в которой символы delimiters (например, табуляция и знаки препинания) - разделители
+    static CharClassTable DefaultTableWithDelimiters(std::string_view delimiters);
+
+    explicit Tokenizer(const CharClassTable& table = DefaultTable());
+
+    /*
+     * Вызывает callback(word) для каждого слова text. Возвращает false, встретив недопустимый символ;
+     * слова, предшествующие ему, к этому моменту уже переданы в callback.
+     */
+    template <typename Callback>
+    bool ForEachWord(std::string_view text, Callback callback) const;
+
+    // позиция первого недопустимого символа text либо npos
+    [[nodiscard]] size_t FindInvalid(std::string_view text) const;
+
+    [[nodiscard]] const CharClassTable& GetTable() const;
+
+private:
+    using FindFunction = size_t (*)(const Tokenizer& tokenizer, std::string_view text, size_t pos);
+
+    CharClassTable table_;
+    //наибольший байт, не относящийся к словам
+    uint8_t max_special_ = 0;
+    FindFunction find_special_;
+
+    // позиция первого байта не из слова, начиная с pos, либо text.size()
+    [[nodiscard]] size_t FindSpecial(std::string_view text, size_t pos) const;
+
+    static size_t FindSpecialScalar(const Tokenizer& tokenizer, std::string_view text, size_t pos);
+#if defined(__x86_64__)
+    static size_t FindSpecialSse2(const Tokenizer& tokenizer, std::string_view text, size_t pos);
+    static size_t FindSpecialAvx2(const Tokenizer& tokenizer, std::string_view text, size_t pos);
+#endif
+};
+
+template <typename Callback>
+bool Tokenizer::ForEachWord(std::string_view text, Callback callback) const {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        const size_t end = FindSpecial(text, pos);
+        if (end > pos) {
+            callback(text.substr(pos, end - pos));
+        }
+        if (end == text.size()) {
+            break;
+        }
+        if (table_[static_cast<uint8_t>(text[end])] == CharClass::INVALID) {
+            return false;
+        }
+        pos = end + 1;
+    }
+    return true;
+}
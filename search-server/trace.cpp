@@ -0,0 +1,251 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    Trace::Clock::time_point start;
+    Trace::Clock::duration duration;
+};
+
+/* Буфер событий одного потока. Пишет только поток-владелец: событие записывается в блок,
+ * затем публикуется увеличением size; читатель видит события [0, size).
+ * Блоки выделяются по мере заполнения, так что поток с парой событий не занимает всю емкость
+ */
+struct ThreadTraceBuffer {
+    static constexpr size_t CHUNK_SIZE = 1024;
+    static constexpr size_t CHUNK_COUNT = Trace::THREAD_BUFFER_CAPACITY / CHUNK_SIZE;
+
+    size_t thread_id;
+    std::array<std::unique_ptr<TraceEvent[]>, CHUNK_COUNT> chunks;
+    std::atomic<size_t> size = 0;
+    std::atomic<size_t> dropped = 0;
+    std::atomic<bool> alive = true;
+
+    //блок с индексом size выделяется до публикации size + 1, поэтому читатель его видит
+    void Push(const TraceEvent& event) {
+        const size_t index = size.load(std::memory_order_relaxed);
+        if (index == Trace::THREAD_BUFFER_CAPACITY) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::unique_ptr<TraceEvent[]>& chunk = chunks[index / CHUNK_SIZE];
+        if (chunk == nullptr) {
+            chunk = std::make_unique<TraceEvent[]>(CHUNK_SIZE);
+        }
+        chunk[index % CHUNK_SIZE] = event;
+        size.store(index + 1, std::memory_order_release);
+    }
+
+    [[nodiscard]] const TraceEvent& operator[](size_t index) const {
+        return chunks[index / CHUNK_SIZE][index % CHUNK_SIZE];
+    }
+};
+
+class TraceRegistry {
+public:
+    ThreadTraceBuffer* Register() {
+        std::lock_guard guard(mutex_);
+        buffers_.push_back(std::make_unique<ThreadTraceBuffer>());
+        buffers_.back()->thread_id = next_thread_id_++;
+        return buffers_.back().get();
+    }
+
+    //пустой буфер завершившегося потока удаляется сразу, остальные - после записи трассы
+    void Retire(ThreadTraceBuffer* buffer) {
+        std::lock_guard guard(mutex_);
+        if (buffer->size.load(std::memory_order_relaxed) == 0) {
+            buffers_.erase(std::find_if(buffers_.begin(), buffers_.end(), [buffer](const auto& registered) {
+                return registered.get() == buffer;
+            }));
+        } else {
+            buffer->alive.store(false, std::memory_order_release);
+        }
+    }
+
+    //буферы завершившихся потоков удаляются, остальные очищаются
+    void Clear() {
+        std::lock_guard guard(mutex_);
+        RemoveRetiredLocked();
+        for (auto& buffer : buffers_) {
+            buffer->size.store(0, std::memory_order_relaxed);
+            buffer->dropped.store(0, std::memory_order_relaxed);
+        }
+        origin_ = Trace::Clock::now();
+    }
+
+    void RemoveRetired() {
+        std::lock_guard guard(mutex_);
+        RemoveRetiredLocked();
+    }
+
+    const char* InternName(std::string_view name) {
+        std::lock_guard guard(mutex_);
+        return names_.emplace(name).first->c_str();
+    }
+
+    template <typename Func>
+    void ForEachBuffer(Func func) const {
+        std::lock_guard guard(mutex_);
+        for (const auto& buffer : buffers_) {
+            func(*buffer);
+        }
+    }
+
+    [[nodiscard]] Trace::Clock::time_point GetOrigin() const {
+        std::lock_guard guard(mutex_);
+        return origin_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadTraceBuffer>> buffers_;
+    std::set<std::string, std::less<>> names_;
+    size_t next_thread_id_ = 1;
+    Trace::Clock::time_point origin_ = Trace::Clock::now();
+
+    void RemoveRetiredLocked() {
+        buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(), [](const auto& buffer) {
+            return !buffer->alive.load(std::memory_order_acquire);
+        }), buffers_.end());
+    }
+};
+
+TraceRegistry& GetRegistry() {
+    return GetLeakedInstance<TraceRegistry>();
+}
+
+//буфер регистрируется при первом событии потока и снимается с учета при завершении потока
+struct ThreadTraceHandle {
+    ThreadTraceBuffer* buffer = GetRegistry().Register();
+
+    ~ThreadTraceHandle() {
+        GetRegistry().Retire(buffer);
+    }
+};
+
+void WriteJsonString(std::ostream& output, std::string_view text) {
+    output << '"';
+    for (const char c : text) {
+        switch (c) {
+            case '"':
+                output << "\\\""sv;
+                break;
+            case '\\':
+                output << "\\\\"sv;
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    output << "\\u"sv << std::hex << std::setw(4) << std::setfill('0')
+                           << static_cast<int>(c) << std::dec << std::setfill(' ');
+                } else {
+                    output << c;
+                }
+        }
+    }
+    output << '"';
+}
+
+//неотрицательное время в микросекундах, как принято в формате Chrome trace event
+void WriteMicroseconds(std::ostream& output, Trace::Clock::duration duration) {
+    const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    output << nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0') << nanoseconds % 1000
+           << std::setfill(' ');
+}
+
+}  // namespace
+
+std::atomic<bool> Trace::enabled_ = false;
+
+void Trace::Start() {
+    GetRegistry().Clear();
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Trace::Stop() {
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+void Trace::Clear() {
+    GetRegistry().Clear();
+}
+
+void Trace::AddEvent(const char* name, Clock::time_point start, Clock::time_point end) {
+    thread_local ThreadTraceHandle handle;
+    handle.buffer->Push({name, start, end - start});
+}
+
+const char* Trace::InternName(std::string_view name) {
+    return GetRegistry().InternName(name);
+}
+
+size_t Trace::GetEventCount() {
+    size_t count = 0;
+    GetRegistry().ForEachBuffer([&count](const ThreadTraceBuffer& buffer) {
+        count += buffer.size.load(std::memory_order_acquire);
+    });
+    return count;
+}
+
+size_t Trace::GetDroppedCount() {
+    size_t count = 0;
+    GetRegistry().ForEachBuffer([&count](const ThreadTraceBuffer& buffer) {
+        count += buffer.dropped.load(std::memory_order_relaxed);
+    });
+    return count;
+}
+
+void Trace::WriteChromeTrace(std::ostream& output) {
+    const Clock::time_point origin = GetRegistry().GetOrigin();
+    output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":["sv;
+    bool first = true;
+    const auto separate = [&output, &first] {
+        if (!first) {
+            output << ",\n"sv;
+        }
+        first = false;
+    };
+    GetRegistry().ForEachBuffer([&](const ThreadTraceBuffer& buffer) {
+        const size_t size = buffer.size.load(std::memory_order_acquire);
+        if (size == 0) {
+            return;
+        }
+        separate();
+        output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"sv << buffer.thread_id
+               << ",\"args\":{\"name\":\"thread "sv << buffer.thread_id << "\"}}"sv;
+        for (size_t i = 0; i < size; ++i) {
+            const TraceEvent& event = buffer[i];
+            separate();
+            output << "{\"name\":"sv;
+            WriteJsonString(output, event.name);
+            output << ",\"ph\":\"X\",\"pid\":1,\"tid\":"sv << buffer.thread_id << ",\"ts\":"sv;
+            WriteMicroseconds(output, std::max(event.start - origin, Clock::duration::zero()));
+            output << ",\"dur\":"sv;
+            WriteMicroseconds(output, event.duration);
+            output << '}';
+        }
+    });
+    output << "]}\n"sv;
+    //события завершившихся потоков записаны, их буферы больше не нужны
+    GetRegistry().RemoveRetired();
+}
+
+void Trace::WriteChromeTrace(const std::string& path) {
+    std::ofstream output(path);
+    if (!output) {
+        throw std::runtime_error("Не удалось открыть файл трассы "s + path);
+    }
+    WriteChromeTrace(output);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "instrumentation.h"
+
+/*
+ * Запись трассы выполнения в формате Chrome trace event (chrome://tracing, Perfetto).
+ * Сборка с -DSEARCH_SERVER_TRACING=0 убирает TRACE_SCOPE из кода полностью.
+ */
+#ifndef SEARCH_SERVER_TRACING
+#define SEARCH_SERVER_TRACING 1
+#endif
+
+/*
+ * Трасса по умолчанию не пишется: между Start и Stop каждый TRACE_SCOPE добавляет событие
+ * (имя, поток, начало и длительность) в буфер своего потока без блокировок. Вложенные области
+ * видны на временной шкале как вложенные отрезки. Буфер потока растет блоками до
+ * THREAD_BUFFER_CAPACITY событий, лишние отбрасываются и учитываются в GetDroppedCount.
+ * Буферы завершившихся потоков освобождаются после записи трассы или при Clear.
+ * Start, Clear и запись трассы вызываются, когда трассируемая работа не выполняется.
+ */
+class Trace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t THREAD_BUFFER_CAPACITY = size_t{1} << 16;
+
+    // очищает буферы и начинает запись
+    static void Start();
+    static void Stop();
+    [[nodiscard]] static bool IsEnabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+    static void Clear();
+
+    // name должно жить до конца программы: строковый литерал или строка из InternName
+    static void AddEvent(const char* name, Clock::time_point start, Clock::time_point end);
+    // постоянная копия имени; повторный вызов с тем же именем возвращает ту же строку
+    [[nodiscard]] static const char* InternName(std::string_view name);
+
+    [[nodiscard]] static size_t GetEventCount();
+    [[nodiscard]] static size_t GetDroppedCount();
+
+    static void WriteChromeTrace(std::ostream& output);
+    // выбрасывает std::runtime_error, если файл не удалось открыть
+    static void WriteChromeTrace(const std::string& path);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+// событие трассы от создания до конца блока
+class TraceScope {
+public:
+    explicit TraceScope(const char* name)
+            : name_(Trace::IsEnabled() ? name : nullptr) {
+        if (name_ != nullptr) {
+            start_time_ = Trace::Clock::now();
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    ~TraceScope() {
+        if (name_ != nullptr) {
+            Trace::AddEvent(name_, start_time_, Trace::Clock::now());
+        }
+    }
+
+private:
+    const char* name_;
+    Trace::Clock::time_point start_time_;
+};
+
+#if SEARCH_SERVER_TRACING
+#define TRACE_SCOPE(name) TraceScope PROFILE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif